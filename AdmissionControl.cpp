@@ -0,0 +1,115 @@
+#include <Urho3D/Math/MathDefs.h>
+
+#include "AdmissionControl.h"
+
+RequestBucket::RequestBucket() :
+	tokens_(0.0f),
+	unlimited_(true),
+	previous_(Vector2::ZERO),
+	previousSequence_(0),
+	hasPrevious_(false)
+{
+}
+
+void RequestBucket::Update(float timeStep, float rate, float burst)
+{
+	// Coalescing is per tick
+	hasPrevious_ = false;
+
+	// A bucket just limited starts full, so enabling a limit does not drop what is already in flight
+	if (rate <= 0.0f)
+	{
+		unlimited_ = true;
+		return;
+	}
+	tokens_ = unlimited_ ? burst : Min(tokens_ + rate * timeStep, burst);
+	unlimited_ = false;
+}
+
+unsigned RequestBucket::Admit(unsigned count)
+{
+	if (unlimited_)
+		return count;
+
+	unsigned admitted = Min((unsigned)tokens_, count);
+	tokens_ -= (float)admitted;
+	return admitted;
+}
+
+void RequestBucket::Refund(unsigned count)
+{
+	if (!unlimited_)
+		tokens_ += (float)count;
+}
+
+bool RequestBucket::Coalesce(const Vector2& position, float coalesceDistance, unsigned sequence)
+{
+	// Redrawing the same circle changes nothing, so it costs nothing either. Only while it is still on top: once another
+	// client's command has been applied in between, the redraw must go through to end up over it
+	if (hasPrevious_ && sequence == previousSequence_ + 1 &&
+		(position - previous_).LengthSquared() <= coalesceDistance * coalesceDistance)
+	{
+		if (!unlimited_)
+			tokens_ += 1.0f;
+		return true;
+	}
+
+	previous_ = position;
+	previousSequence_ = sequence;
+	hasPrevious_ = true;
+	return false;
+}
+
+AdmissionControl::AdmissionControl() :
+	rate_(0.0f),
+	burst_(0.0f),
+	calmTime_(0.0f),
+	overloaded_(false),
+	numOverloads_(0)
+{
+}
+
+void AdmissionControl::SetLimits(float rate, float burst)
+{
+	rate_ = Max(rate, 0.0f);
+	burst_ = Max(burst, 0.0f);
+}
+
+bool AdmissionControl::Update(float timeStep, unsigned backlog, unsigned queueDepthPerClient)
+{
+	if (!overloaded_)
+	{
+		if (backlog <= OVERLOAD_BACKLOG && queueDepthPerClient <= OVERLOAD_QUEUE_DEPTH)
+			return false;
+		overloaded_ = true;
+		calmTime_ = 0.0f;
+		++numOverloads_;
+		return true;
+	}
+
+	// Leaving only after a calm period keeps the server from flapping at the threshold
+	if (backlog * 2 > OVERLOAD_BACKLOG || queueDepthPerClient * 2 > OVERLOAD_QUEUE_DEPTH)
+		calmTime_ = 0.0f;
+	else
+		calmTime_ += timeStep;
+	if (calmTime_ < OVERLOAD_RECOVERY_SECONDS)
+		return false;
+	overloaded_ = false;
+	return true;
+}
+
+float AdmissionControl::GetRate() const
+{
+	if (!overloaded_)
+		return rate_;
+	return rate_ > 0.0f ? rate_ * OVERLOAD_RATE_FACTOR : OVERLOAD_REQUEST_RATE;
+}
+
+float AdmissionControl::GetBurst() const
+{
+	// At least one request, or none would ever get through
+	float burst = burst_ > 0.0f ? burst_ : rate_;
+	if (overloaded_)
+		burst = Min(burst > 0.0f ? burst : OVERLOAD_REQUEST_RATE, GetRate());
+	return Max(burst, 1.0f);
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <Urho3D/Math/Vector2.h>
+
+using namespace Urho3D;
+
+/// Per client draw request rate in overload when no limit is configured, in requests per second.
+static const float OVERLOAD_REQUEST_RATE = 20.0f;
+/// Factor a configured request rate is multiplied with in overload.
+static const float OVERLOAD_RATE_FACTOR = 0.5f;
+/// Table pixels within which a request coalesces with its client's previous one of the same tick in overload. Outside
+/// overload only requests at the very same position coalesce.
+static const float OVERLOAD_COALESCE_PIXELS = 2.5f;
+/// Decoded commands waiting at the start of a tick above which the server is overloaded.
+static const unsigned OVERLOAD_BACKLOG = 4096;
+/// Messages per client waiting to go out above which the server is overloaded.
+static const unsigned OVERLOAD_QUEUE_DEPTH = 256;
+/// Seconds both signals must stay below half their threshold before overload ends.
+static const float OVERLOAD_RECOVERY_SECONDS = 2.0f;
+
+/// Token bucket for the draw requests of one client. Budget is taken when a batch arrives, so requests over it are never
+/// decoded. Every request is acknowledged whatever the decision, so the client rolls back predictions of those not applied.
+class RequestBucket
+{
+public:
+	/// Construct unlimited.
+	RequestBucket();
+
+	/// Start a tick: refill for elapsed time at a rate in requests per second, holding at most burst requests. Zero rate
+	/// is unlimited.
+	void Update(float timeStep, float rate, float burst);
+	/// Take budget for a batch of count requests as it arrives. Return how many of its first requests are admitted, the
+	/// rest are dropped.
+	unsigned Admit(unsigned count);
+	/// Give back the budget of count admitted requests that were not decoded after all.
+	void Refund(unsigned count);
+	/// Return whether an admitted request at table position coalesces with the previous one applied in the same tick, being
+	/// within coalesceDistance pixels of it with no other command applied since. Sequence is the history sequence number
+	/// the request would be applied with. A coalesced request gives its budget back.
+	bool Coalesce(const Vector2& position, float coalesceDistance, unsigned sequence);
+
+private:
+	/// Requests that may be admitted now.
+	float tokens_;
+	/// Whether the bucket is unlimited.
+	bool unlimited_;
+	/// Table position of the previous request applied this tick.
+	Vector2 previous_;
+	/// History sequence number of the previous request applied this tick.
+	unsigned previousSequence_;
+	/// Whether a request has been applied this tick.
+	bool hasPrevious_;
+};
+
+/// Server-wide admission limits and overload state. Overload starts when decoded requests pile up ahead of the tick or
+/// the clients' outgoing queues grow, and then tightens every client's request budget and coalesces nearby requests
+/// until both have stayed low for a while.
+class AdmissionControl
+{
+public:
+	/// Construct unlimited and not overloaded.
+	AdmissionControl();
+
+	/// Set request rate per client in requests per second and burst in requests. Zero rate is unlimited, zero burst one
+	/// second of the rate.
+	void SetLimits(float rate, float burst);
+	/// Update overload state from the signals at the start of a tick. Return whether it changed.
+	bool Update(float timeStep, unsigned backlog, unsigned queueDepthPerClient);
+
+	/// Return request rate per client in effect, zero if unlimited.
+	float GetRate() const;
+	/// Return request burst per client in effect.
+	float GetBurst() const;
+	/// Return coalescing distance in table pixels in effect.
+	float GetCoalesceDistance() const { return overloaded_ ? OVERLOAD_COALESCE_PIXELS : 0.0f; }
+	/// Return whether the server is overloaded.
+	bool IsOverloaded() const { return overloaded_; }
+	/// Return number of times overload started.
+	unsigned GetNumOverloads() const { return numOverloads_; }
+
+private:
+	/// Configured rate, zero if unlimited.
+	float rate_;
+	/// Configured burst, zero for one second of the rate.
+	float burst_;
+	/// Time both signals have been below half their threshold during overload.
+	float calmTime_;
+	/// Overload flag.
+	bool overloaded_;
+	/// Number of overloads.
+	unsigned numOverloads_;
+};
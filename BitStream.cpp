@@ -0,0 +1,110 @@
+#include <Urho3D/IO/Deserializer.h>
+#include <Urho3D/IO/Serializer.h>
+#include <Urho3D/Math/MathDefs.h>
+
+#include "BitStream.h"
+
+static const unsigned VLE_GROUP_BITS = 4;
+
+static unsigned LowMask(unsigned bits)
+{
+	return (unsigned)((1ULL << bits) - 1);
+}
+
+QuantizedRange::QuantizedRange(float min, float max, unsigned bits) :
+	min_(min),
+	max_(max),
+	bits_(Clamp(bits, 1U, 32U)),
+	maxValue_(LowMask(bits_))
+{
+}
+
+unsigned QuantizedRange::Quantize(float value) const
+{
+	double steps = ((double)value - min_) / ((double)max_ - min_) * maxValue_;
+	return steps <= 0.0 ? 0 : steps >= maxValue_ ? maxValue_ : (unsigned)floor(steps + 0.5);
+}
+
+float QuantizedRange::Dequantize(unsigned value) const
+{
+	return (float)(min_ + ((double)max_ - min_) * Min(value, maxValue_) / maxValue_);
+}
+
+BitWriter::BitWriter(Serializer& dest) :
+	dest_(dest),
+	buffer_(0),
+	numBits_(0)
+{
+}
+
+void BitWriter::Write(unsigned value, unsigned bits)
+{
+	buffer_ |= (unsigned long long)(value & LowMask(bits)) << numBits_;
+	numBits_ += bits;
+	while (numBits_ >= 8)
+	{
+		dest_.WriteUByte((unsigned char)buffer_);
+		buffer_ >>= 8;
+		numBits_ -= 8;
+	}
+}
+
+void BitWriter::WriteVLE(unsigned value)
+{
+	for (;;)
+	{
+		Write(value, VLE_GROUP_BITS);
+		value >>= VLE_GROUP_BITS;
+		WriteBit(value != 0);
+		if (!value)
+			break;
+	}
+}
+
+void BitWriter::Flush()
+{
+	if (numBits_)
+		dest_.WriteUByte((unsigned char)buffer_);
+	buffer_ = 0;
+	numBits_ = 0;
+}
+
+BitReader::BitReader(Deserializer& source) :
+	source_(source),
+	buffer_(0),
+	numBits_(0),
+	eof_(false)
+{
+}
+
+unsigned BitReader::Read(unsigned bits)
+{
+	while (numBits_ < bits)
+	{
+		if (source_.IsEof())
+		{
+			eof_ = true;
+			numBits_ = bits;
+			break;
+		}
+		buffer_ |= (unsigned long long)source_.ReadUByte() << numBits_;
+		numBits_ += 8;
+	}
+
+	unsigned value = (unsigned)(buffer_ & LowMask(bits));
+	buffer_ >>= bits;
+	numBits_ -= bits;
+	return value;
+}
+
+unsigned BitReader::ReadVLE()
+{
+	unsigned value = 0;
+	for (unsigned shift = 0; shift < 32; shift += VLE_GROUP_BITS)
+	{
+		value |= Read(VLE_GROUP_BITS) << shift;
+		if (!ReadBit())
+			break;
+	}
+	return value;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <Urho3D/Container/Vector.h>
+
+namespace Urho3D
+{
+
+class Deserializer;
+class Serializer;
+
+}
+
+using namespace Urho3D;
+
+/// Network encoding of a float value: range and bit count. Values are clamped to the range and quantized to evenly spaced
+/// steps including both ends, so the precision is (max - min) / (2^bits - 1).
+struct QuantizedRange
+{
+	/// Construct from range and bit count (1-32.)
+	QuantizedRange(float min, float max, unsigned bits);
+
+	/// Return quantized value.
+	unsigned Quantize(float value) const;
+	/// Return value of quantized value.
+	float Dequantize(unsigned value) const;
+	/// Return value as it arrives after quantization.
+	float Round(float value) const { return Dequantize(Quantize(value)); }
+
+	/// Smallest value.
+	float min_;
+	/// Largest value.
+	float max_;
+	/// Bits per value.
+	unsigned bits_;
+	/// Largest quantized value.
+	unsigned maxValue_;
+};
+
+/// Writes values of any bit count back to back, least significant bit first. Whole bytes go to the destination as soon as
+/// they are complete; Flush() pads the last one.
+class BitWriter
+{
+public:
+	/// Construct.
+	BitWriter(Serializer& dest);
+
+	/// Write the low bits (0-32) of value.
+	void Write(unsigned value, unsigned bits);
+	/// Write one bit.
+	void WriteBit(bool value) { Write(value ? 1 : 0, 1); }
+	/// Write unsigned value in groups of four bits, each followed by a bit telling whether more follow. Small values take five bits.
+	void WriteVLE(unsigned value);
+	/// Write float quantized by range.
+	void WriteQuantized(float value, const QuantizedRange& range) { Write(range.Quantize(value), range.bits_); }
+	/// Write the partial last byte, padded with zero bits.
+	void Flush();
+
+private:
+	/// Destination.
+	Serializer& dest_;
+	/// Bits not yet written.
+	unsigned long long buffer_;
+	/// Number of bits in buffer_.
+	unsigned numBits_;
+};
+
+/// Reads values written by BitWriter.
+class BitReader
+{
+public:
+	/// Construct.
+	BitReader(Deserializer& source);
+
+	/// Read value of bit count (0-32.) Bits past the end of the source read as zero.
+	unsigned Read(unsigned bits);
+	/// Read one bit.
+	bool ReadBit() { return Read(1) != 0; }
+	/// Read value written by BitWriter::WriteVLE.
+	unsigned ReadVLE();
+	/// Read float quantized by range.
+	float ReadQuantized(const QuantizedRange& range) { return range.Dequantize(Read(range.bits_)); }
+
+	/// Return whether reading went past the end of the source.
+	bool IsEof() const { return eof_; }
+
+private:
+	/// Source.
+	Deserializer& source_;
+	/// Bits read from the source but not yet returned.
+	unsigned long long buffer_;
+	/// Number of bits in buffer_.
+	unsigned numBits_;
+	/// Past end flag.
+	bool eof_;
+};
@@ -0,0 +1,56 @@
+#include <Urho3D/Math/MathDefs.h>
+
+#include <cstring>
+
+#include "ByteArena.h"
+
+ByteArena::ByteArena(unsigned chunkSize) :
+	current_(0),
+	offset_(0),
+	chunkSize_(Max(chunkSize, 1U)),
+	used_(0)
+{
+}
+
+ByteArena::~ByteArena()
+{
+	for (unsigned i = 0; i < chunks_.Size(); ++i)
+		delete[] chunks_[i];
+}
+
+unsigned char* ByteArena::Allocate(unsigned size)
+{
+	// Move on to the next chunk that fits, allocating one if none is left
+	while (current_ < chunks_.Size() && offset_ + size > chunkSizes_[current_])
+	{
+		++current_;
+		offset_ = 0;
+	}
+	if (current_ == chunks_.Size())
+	{
+		unsigned chunkSize = Max(size, chunkSize_);
+		chunks_.Push(new unsigned char[chunkSize]);
+		chunkSizes_.Push(chunkSize);
+		offset_ = 0;
+	}
+
+	unsigned char* block = chunks_[current_] + offset_;
+	offset_ += size;
+	used_ += size;
+	return block;
+}
+
+unsigned char* ByteArena::Store(const void* data, unsigned size)
+{
+	unsigned char* block = Allocate(size);
+	if (size)
+		memcpy(block, data, size);
+	return block;
+}
+
+void ByteArena::Reset()
+{
+	current_ = 0;
+	offset_ = 0;
+	used_ = 0;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <Urho3D/Container/Vector.h>
+
+using namespace Urho3D;
+
+/// Default size of an arena chunk in bytes.
+static const unsigned DEFAULT_ARENA_CHUNK_SIZE = 64 * 1024;
+
+/// Bump allocator for short-lived byte blocks. Blocks are carved from large chunks and never freed individually; Reset()
+/// releases all of them at once and keeps the chunks, so a steady workload stops allocating after warming up.
+class ByteArena
+{
+public:
+	/// Construct with chunk size.
+	ByteArena(unsigned chunkSize = DEFAULT_ARENA_CHUNK_SIZE);
+	/// Destruct. Frees the chunks.
+	~ByteArena();
+
+	/// Return a block of size bytes, valid until the next Reset().
+	unsigned char* Allocate(unsigned size);
+	/// Copy bytes into a new block and return it.
+	unsigned char* Store(const void* data, unsigned size);
+	/// Release all blocks. Chunks are kept for reuse.
+	void Reset();
+
+	/// Return bytes handed out since the last reset.
+	unsigned GetUsed() const { return used_; }
+	/// Return number of chunks allocated.
+	unsigned GetNumChunks() const { return chunks_.Size(); }
+
+private:
+	/// Prevent copy construction.
+	ByteArena(const ByteArena& rhs);
+	/// Prevent assignment.
+	ByteArena& operator =(const ByteArena& rhs);
+
+	/// Chunk memory.
+	PODVector<unsigned char*> chunks_;
+	/// Size of each chunk. Blocks larger than the chunk size get a chunk of their own size.
+	PODVector<unsigned> chunkSizes_;
+	/// Chunk blocks are carved from.
+	unsigned current_;
+	/// Offset of the next block in the current chunk.
+	unsigned offset_;
+	/// Size of new chunks.
+	unsigned chunkSize_;
+	/// Bytes handed out since the last reset.
+	unsigned used_;
+};
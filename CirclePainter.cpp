@@ -1,9 +1,11 @@
 #include <Urho3D/Core/Context.h>
 #include <Urho3D/Graphics/AnimationController.h>
 #include <Urho3D/IO/MemoryBuffer.h>
+#include <Urho3D/IO/VectorBuffer.h>
 #include <Urho3D/Scene/Scene.h>
 #include <Urho3D/Scene/SceneEvents.h>
 #include <Urho3D/Input/Input.h>
+#include <Urho3D/Network/Connection.h>
 #include <Urho3D/Network/Network.h>
 #include <Urho3D/Network/NetworkEvents.h>
 #include <Urho3D/Urho2D/StaticSprite2D.h>
@@ -15,8 +17,11 @@
 
 #include "CirclePainter.h"
 #include "Common.h"
+#include "DrawCommand.h"
+#include "MessagePool.h"
+#include "DrawStats.h"
 
-CirclePainter::CirclePainter(Context* ctx) : LogicComponent(ctx)
+CirclePainter::CirclePainter(Context* ctx) : LogicComponent(ctx), _pendingSequence(1), _nextSequence(1)
 {
 }
 
@@ -31,17 +36,40 @@ void CirclePainter::Stop()
 void CirclePainter::RegisterObject(Context* context)
 {
 	context->RegisterFactory<CirclePainter>();
-	URHO3D_ATTRIBUTE("Color", Color, _color, Color::WHITE, AM_DEFAULT);
+	// Saved as is, replicated quantized like in draw commands
+	URHO3D_ATTRIBUTE("Color", Color, _color, Color::WHITE, AM_FILE);
+	URHO3D_ACCESSOR_ATTRIBUTE("Network Color", GetNetworkColor, SetNetworkColor, unsigned, PackDrawColor(Color::WHITE),
+		AM_NET | AM_NOEDIT);
 }
 
-void CirclePainter::TakeAuthority()
+void CirclePainter::TakeAuthority(Network* network)
 {
+	_network = network ? network : GetSubsystem<Network>();
 	SubscribeToEvent(E_MOUSEBUTTONUP, URHO3D_HANDLER(CirclePainter, OnMouseUp));
+	SubscribeToEvent(_network, E_NETWORKUPDATE, URHO3D_HANDLER(CirclePainter, OnNetworkUpdate));
 }
 
 void CirclePainter::ResetAuthority()
 {
 	UnsubscribeFromEvent(E_MOUSEBUTTONUP);
+	UnsubscribeFromEvent(_network, E_NETWORKUPDATE);
+	_network.Reset();
+	_pendingDraws.Clear();
+	_pendingSequence = _nextSequence;
+}
+
+unsigned CirclePainter::QueueDraw(const Vector2& position)
+{
+	// Sent together with other requests of this network tick
+	Connection* serverConnection = _network ? _network->GetServerConnection() : 0;
+	if (!serverConnection || !IsOnTable(position))
+		return 0;
+	_pendingDraws.Push(position);
+
+	DrawStats* stats = GetSubsystem<DrawStats>();
+	if (stats)
+		stats->RequestSent(serverConnection, _nextSequence, QuantizeDrawPosition(position), _color);
+	return _nextSequence++;
 }
 
 void CirclePainter::OnMouseUp(StringHash type, VariantMap& args)
@@ -51,26 +79,60 @@ void CirclePainter::OnMouseUp(StringHash type, VariantMap& args)
 
 	if (b == MOUSEB_LEFT)
 	{
-		Network* network = GetSubsystem<Network>();
-		Connection* serverConnection = network->GetServerConnection();
-		if (serverConnection)
-		{
-			VariantMap packet;
-			packet[P_ID] = GetNode()->GetID();
-			Graphics* graphics = GetSubsystem<Graphics>();
-
-			// Convert click position to world space. Camera at (0,0,0) always and looking forward
-			Vector2 halfSize(graphics->GetWidth() / 2.0f, graphics->GetHeight() / 2.0f);
-			IntVector2 v = input->GetMousePosition();
-			Vector2 pos(v.x_, v.y_);
-			pos = halfSize - pos;
-			pos *= PIXEL_SIZE;
-			pos.x_ = -pos.x_;
-
-			packet[P_DC_POSITION] = pos;
-			serverConnection->SendRemoteEvent(E_DRAWCOMMAND_REQUEST, true, packet);
-		}
+		Graphics* graphics = GetSubsystem<Graphics>();
+
+		// Convert click position to world space. Camera at (0,0,0) always and looking forward
+		Vector2 halfSize(graphics->GetWidth() / 2.0f, graphics->GetHeight() / 2.0f);
+		IntVector2 v = input->GetMousePosition();
+		Vector2 pos(v.x_, v.y_);
+		pos = halfSize - pos;
+		pos *= PIXEL_SIZE;
+		pos.x_ = -pos.x_;
+
+		unsigned sequence = QueueDraw(pos);
+		if (!sequence)
+			return;
+
+		// Let the client draw the circle right away, where and how the server is expected to draw it
+		using namespace DrawPredicted;
+		VariantMap& eventData = GetEventDataMap();
+		eventData[P_SEQUENCE] = sequence;
+		eventData[P_POSITION] = QuantizeDrawPosition(pos);
+		eventData[P_COLOR] = _color;
+		SendEvent(E_DRAWPREDICTED, eventData);
+	}
+}
+
+void CirclePainter::OnNetworkUpdate(StringHash type, VariantMap& args)
+{
+	if (_pendingDraws.Empty())
+		return;
+
+	Connection* serverConnection = _network ? _network->GetServerConnection() : 0;
+	if (!serverConnection)
+	{
+		_pendingDraws.Clear();
+		_pendingSequence = _nextSequence;
+		return;
+	}
+
+	PooledMessage msg(GetSubsystem<MessagePool>(), Min(_pendingDraws.Size(), MAX_DRAWCOMMANDS_PER_BATCH) * DRAWCOMMAND_RESERVE_SIZE);
+	unsigned start = 0;
+	while (start < _pendingDraws.Size())
+	{
+		unsigned count = Min(_pendingDraws.Size() - start, MAX_DRAWCOMMANDS_PER_BATCH);
+		msg->Clear();
+		msg->WriteUInt(_pendingSequence + start);
+		msg->WriteVLE(count);
+		BitWriter bits(*msg);
+		for (unsigned i = start; i < start + count; ++i)
+			WriteDrawPosition(bits, _pendingDraws[i]);
+		bits.Flush();
+		serverConnection->SendMessage(MSG_DRAWREQUESTBATCH, true, true, *msg);
+		start += count;
 	}
+	_pendingDraws.Clear();
+	_pendingSequence = _nextSequence;
 }
 
 void CirclePainter::SetColor(const Color& color)
@@ -82,4 +144,14 @@ void CirclePainter::SetColor(const Color& color)
 Color CirclePainter::GetColor() const
 {
 	return _color;
+}
+
+void CirclePainter::SetNetworkColor(unsigned value)
+{
+	_color = UnpackDrawColor(value);
+}
+
+unsigned CirclePainter::GetNetworkColor() const
+{
+	return PackDrawColor(_color);
 }
\ No newline at end of file
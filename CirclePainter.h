@@ -3,8 +3,23 @@
 // #include <Urho3D/Input/Controls.h>
 #include <Urho3D/Scene/LogicComponent.h>
 
+namespace Urho3D
+{
+
+class Network;
+
+}
+
 using namespace Urho3D;
 
+/// Own draw request queued from input. Sent so the circle can be drawn before the server confirms it.
+URHO3D_EVENT(E_DRAWPREDICTED, DrawPredicted)
+{
+	URHO3D_PARAM(P_SEQUENCE, Sequence);		// unsigned
+	URHO3D_PARAM(P_POSITION, Position);		// Vector2, quantized like on the wire
+	URHO3D_PARAM(P_COLOR, Color);			// Color
+}
+
 class CirclePainter : public LogicComponent
 {
 	URHO3D_OBJECT(CirclePainter, LogicComponent);
@@ -16,15 +31,30 @@ public:
 
 	static void CirclePainter::RegisterObject(Context* context);
 
-	// CLient should take control over entity
-	void TakeAuthority();
+	// CLient should take control over entity. Requests go through the given network, or the Network subsystem if null
+	void TakeAuthority(Network* network = 0);
 	void ResetAuthority();
+	// Request circle at world position with the next network update. Return request sequence number, or 0 if not sent
+	unsigned QueueDraw(const Vector2& position);
 
 	void OnMouseUp(StringHash type, VariantMap& args);
+	// Send draw requests collected since the previous network update as one batch
+	void OnNetworkUpdate(StringHash type, VariantMap& args);
 
 	void		SetColor(const Color& value);
 	Color		GetColor() const;
+	// Color packed like in draw commands for replication
+	void		SetNetworkColor(unsigned value);
+	unsigned	GetNetworkColor() const;
 
 private:
 	Color				_color;
+	// Draw requests waiting for the next network update
+	PODVector<Vector2>	_pendingDraws;
+	// Sequence number of the first pending request. The server acknowledges requests by these
+	unsigned			_pendingSequence;
+	// Sequence number of the next request
+	unsigned			_nextSequence;
+	// Network whose server connection carries the requests
+	WeakPtr<Network>	_network;
 };
\ No newline at end of file
@@ -0,0 +1,252 @@
+#include <Urho3D/Math/MathDefs.h>
+
+#include "CircleRasterizer.h"
+
+#include <cmath>
+#include <cstring>
+
+#ifdef URHO3D_SSE
+#include <emmintrin.h>
+#endif
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+/// Alpha in 1/256 steps at and above which pixels are overwritten instead of blended.
+static const int OPAQUE_ALPHA = 256;
+/// Spans shorter than this are not worth building the SIMD pattern for.
+static const int MIN_SIMD_SPAN = 16;
+
+/// Repeat an RGB triplet over a 16 pixel (48 byte) pattern, so that any 16 byte block at a multiple of 16 matches pixel layout.
+static void MakePattern(unsigned char* pattern, const unsigned char* rgb)
+{
+	for (int i = 0; i < 48; i += 3)
+	{
+		pattern[i] = rgb[0];
+		pattern[i + 1] = rgb[1];
+		pattern[i + 2] = rgb[2];
+	}
+}
+
+static inline unsigned char BlendChannel(unsigned char dest, unsigned char src, int alpha)
+{
+	return (unsigned char)((src * alpha + dest * (256 - alpha)) >> 8);
+}
+
+static void FillSpanScalar(unsigned char* dest, unsigned char* end, const unsigned char* rgb)
+{
+	for (; dest < end; dest += 3)
+	{
+		dest[0] = rgb[0];
+		dest[1] = rgb[1];
+		dest[2] = rgb[2];
+	}
+}
+
+static void BlendSpanScalar(unsigned char* dest, unsigned char* end, const unsigned char* rgb, int alpha)
+{
+	for (; dest < end; dest += 3)
+	{
+		dest[0] = BlendChannel(dest[0], rgb[0], alpha);
+		dest[1] = BlendChannel(dest[1], rgb[1], alpha);
+		dest[2] = BlendChannel(dest[2], rgb[2], alpha);
+	}
+}
+
+static void FillSpan(unsigned char* dest, int count, const unsigned char* rgb)
+{
+	unsigned char* end = dest + count * 3;
+	if (count < MIN_SIMD_SPAN)
+	{
+		FillSpanScalar(dest, end, rgb);
+		return;
+	}
+
+#if defined(__AVX2__) || defined(URHO3D_SSE)
+	unsigned char pattern[96];
+	MakePattern(pattern, rgb);
+	memcpy(pattern + 48, pattern, 48);
+#endif
+
+#ifdef __AVX2__
+	__m256i p0 = _mm256_loadu_si256((const __m256i*)pattern);
+	__m256i p1 = _mm256_loadu_si256((const __m256i*)(pattern + 32));
+	__m256i p2 = _mm256_loadu_si256((const __m256i*)(pattern + 64));
+	while (end - dest >= 96)
+	{
+		_mm256_storeu_si256((__m256i*)dest, p0);
+		_mm256_storeu_si256((__m256i*)(dest + 32), p1);
+		_mm256_storeu_si256((__m256i*)(dest + 64), p2);
+		dest += 96;
+	}
+#endif
+
+#ifdef URHO3D_SSE
+	__m128i q0 = _mm_loadu_si128((const __m128i*)pattern);
+	__m128i q1 = _mm_loadu_si128((const __m128i*)(pattern + 16));
+	__m128i q2 = _mm_loadu_si128((const __m128i*)(pattern + 32));
+	while (end - dest >= 48)
+	{
+		_mm_storeu_si128((__m128i*)dest, q0);
+		_mm_storeu_si128((__m128i*)(dest + 16), q1);
+		_mm_storeu_si128((__m128i*)(dest + 32), q2);
+		dest += 48;
+	}
+#endif
+
+	FillSpanScalar(dest, end, rgb);
+}
+
+#ifdef URHO3D_SSE
+static inline __m128i BlendBlock(__m128i dest, __m128i srcLo, __m128i srcHi, __m128i invAlpha)
+{
+	__m128i zero = _mm_setzero_si128();
+	__m128i lo = _mm_add_epi16(srcLo, _mm_mullo_epi16(_mm_unpacklo_epi8(dest, zero), invAlpha));
+	__m128i hi = _mm_add_epi16(srcHi, _mm_mullo_epi16(_mm_unpackhi_epi8(dest, zero), invAlpha));
+	return _mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8));
+}
+#endif
+
+static void BlendSpan(unsigned char* dest, int count, const unsigned char* rgb, int alpha)
+{
+	if (alpha >= OPAQUE_ALPHA)
+	{
+		FillSpan(dest, count, rgb);
+		return;
+	}
+	if (alpha <= 0)
+		return;
+
+	unsigned char* end = dest + count * 3;
+	if (count < MIN_SIMD_SPAN)
+	{
+		BlendSpanScalar(dest, end, rgb, alpha);
+		return;
+	}
+
+#ifdef URHO3D_SSE
+	unsigned char pattern[48];
+	MakePattern(pattern, rgb);
+
+	// Source terms src * alpha are constant along the span, precompute them per pattern block
+	__m128i zero = _mm_setzero_si128();
+	__m128i a = _mm_set1_epi16((short)alpha);
+	__m128i invA = _mm_set1_epi16((short)(256 - alpha));
+	__m128i srcLo[3];
+	__m128i srcHi[3];
+	for (int i = 0; i < 3; ++i)
+	{
+		__m128i p = _mm_loadu_si128((const __m128i*)(pattern + i * 16));
+		srcLo[i] = _mm_mullo_epi16(_mm_unpacklo_epi8(p, zero), a);
+		srcHi[i] = _mm_mullo_epi16(_mm_unpackhi_epi8(p, zero), a);
+	}
+
+	while (end - dest >= 48)
+	{
+		for (int i = 0; i < 3; ++i)
+		{
+			__m128i* block = (__m128i*)(dest + i * 16);
+			_mm_storeu_si128(block, BlendBlock(_mm_loadu_si128(block), srcLo[i], srcHi[i], invA));
+		}
+		dest += 48;
+	}
+#endif
+
+	BlendSpanScalar(dest, end, rgb, alpha);
+}
+
+static inline int ToAlpha(float value)
+{
+	return Clamp((int)(value * 256.0f + 0.5f), 0, OPAQUE_ALPHA);
+}
+
+static inline void GrowRect(IntRect& rect, int left, int right, int y)
+{
+	rect.left_ = Min(rect.left_, left);
+	rect.right_ = Max(rect.right_, right);
+	rect.top_ = Min(rect.top_, y);
+	rect.bottom_ = Max(rect.bottom_, y + 1);
+}
+
+IntRect RasterizeCircle(const RasterTarget& target, const Vector2& center, float diameter, const Color& color, bool antiAlias)
+{
+	unsigned char rgb[3];
+	rgb[0] = (unsigned char)Clamp((int)(color.r_ * 255.0f + 0.5f), 0, 255);
+	rgb[1] = (unsigned char)Clamp((int)(color.g_ * 255.0f + 0.5f), 0, 255);
+	rgb[2] = (unsigned char)Clamp((int)(color.b_ * 255.0f + 0.5f), 0, 255);
+	int alpha = ToAlpha(color.a_);
+
+	float r = diameter * 0.5f;
+	IntRect dirty(target.width_, target.height_, 0, 0);
+
+	if (!antiAlias)
+	{
+		// Whole pixel center, spans end at the rounded circle edge on each line
+		int cx = (int)floorf(center.x_);
+		int cy = (int)floorf(center.y_);
+		int first = Max((int)ceilf(cy - r), 0);
+		int last = Min((int)floorf(cy + r), target.height_ - 1);
+		for (int y = first; y <= last; ++y)
+		{
+			float dy = (float)(y - cy);
+			float halfWidth = sqrtf(Max(r * r - dy * dy, 0.0f));
+			int x1 = Clamp((int)(cx + halfWidth + 0.5f), 0, target.width_);
+			int x2 = Clamp((int)(cx - halfWidth + 0.5f), 0, target.width_);
+			if (x1 <= x2)
+				continue;
+
+			BlendSpan(target.data_ + y * target.stride_ + x2 * 3, x1 - x2, rgb, alpha);
+			GrowRect(dirty, x2, x1, y);
+		}
+	}
+	else
+	{
+		// Pixels whose center is within r - 0.5 of the circle center are fully covered, pixels up to r + 0.5 partially
+		float inner = Max(r - 0.5f, 0.0f);
+		float outer = r + 0.5f;
+		int first = Max((int)floorf(center.y_ - outer), 0);
+		int last = Min((int)ceilf(center.y_ + outer), target.height_ - 1);
+		for (int y = first; y <= last; ++y)
+		{
+			float dy = y + 0.5f - center.y_;
+			float dy2 = dy * dy;
+			if (dy2 >= outer * outer)
+				continue;
+
+			float outerHalf = sqrtf(outer * outer - dy2);
+			int x2 = Clamp((int)floorf(center.x_ - outerHalf), 0, target.width_);
+			int x1 = Clamp((int)ceilf(center.x_ + outerHalf), 0, target.width_);
+			if (x1 <= x2)
+				continue;
+
+			// Fully covered run in the middle of the span
+			int in2 = x1;
+			int in1 = x1;
+			if (dy2 < inner * inner)
+			{
+				float innerHalf = sqrtf(inner * inner - dy2);
+				in2 = Clamp((int)ceilf(center.x_ - innerHalf - 0.5f), x2, x1);
+				in1 = Clamp((int)floorf(center.x_ + innerHalf - 0.5f) + 1, in2, x1);
+			}
+
+			unsigned char* row = target.data_ + y * target.stride_;
+			for (int x = x2; x < x1; ++x)
+			{
+				if (x == in2 && in1 > in2)
+				{
+					BlendSpan(row + x * 3, in1 - in2, rgb, alpha);
+					x = in1 - 1;
+					continue;
+				}
+
+				float dx = x + 0.5f - center.x_;
+				float coverage = Clamp(outer - sqrtf(dx * dx + dy2), 0.0f, 1.0f);
+				BlendSpan(row + x * 3, 1, rgb, ToAlpha(coverage * color.a_));
+			}
+
+			GrowRect(dirty, x2, x1, y);
+		}
+	}
+
+	return dirty.right_ > dirty.left_ ? dirty : IntRect::ZERO;
+}
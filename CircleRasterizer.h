@@ -0,0 +1,30 @@
+#pragma once
+
+#include <Urho3D/Math/Color.h>
+#include <Urho3D/Math/Rect.h>
+#include <Urho3D/Math/Vector2.h>
+
+using namespace Urho3D;
+
+/// RGB888 pixel rows a circle is rasterized into.
+struct RasterTarget
+{
+	/// Construct.
+	RasterTarget(unsigned char* data, int width, int height, int stride) :
+		data_(data), width_(width), height_(height), stride_(stride) {}
+
+	/// First pixel of the first row.
+	unsigned char* data_;
+	/// Width in pixels.
+	int width_;
+	/// Height in pixels.
+	int height_;
+	/// Distance between rows in bytes.
+	int stride_;
+};
+
+/// Rasterize filled circle centered at pixel coordinates with any diameter. Color alpha blends against existing contents.
+/// Without anti-aliasing the circle is snapped to whole pixels, with it edge pixels are blended by their coverage.
+/// Spans are filled with AVX2 or SSE2 when the build enables them, otherwise with scalar code. Return touched pixel rectangle,
+/// or IntRect::ZERO if the circle lies outside the target.
+IntRect RasterizeCircle(const RasterTarget& target, const Vector2& center, float diameter, const Color& color, bool antiAlias);
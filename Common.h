@@ -1,8 +1,34 @@
 #pragma once
 #include "Urho3D/Math/StringHash.h"
 
+/// Remote event from server to client which tells the node ID of the client's painter.
+extern const Urho3D::StringHash E_CLIENTOBJECTID;
+/// Node ID parameter in the E_CLIENTOBJECTID event data.
 extern const Urho3D::StringHash P_ID;
 
-extern const Urho3D::StringHash E_DRAWCOMMAND_REQUEST;
-extern const Urho3D::StringHash E_DRAWCOMMAND_CONFIRM;
-extern const Urho3D::StringHash P_DC_POSITION;
+/// Client->Server: batch of draw requests collected during one network update. Payload: client sequence number of the first request, VLE count, then quantized positions.
+static const int MSG_DRAWREQUESTBATCH = 0x80;
+/// Server->Client: batch of confirmed draw commands collected during one network update, filtered by the receiver's region of interest.
+/// Payload: first sequence number, VLE count, then runs of VLE sequence gap, VLE run length and commands in DrawCommand.h wire format.
+static const int MSG_DRAWCONFIRMBATCH = 0x81;
+/// Server->Client: compressed band of the table image, sent on join and for newly covered regions of interest. Payload: sequence number
+/// of the first command not contained, server tick as of the band, then the band.
+static const int MSG_TABLESNAPSHOT = 0x82;
+/// Server->Client: sent after the confirm broadcast. Payload: client sequence number of the last request processed, so predictions up to it can be resolved.
+static const int MSG_DRAWREQUESTACK = 0x83;
+/// Client->Server: visible table region. Only commands touching it are sent to the client. Payload: left, top, right, bottom table pixel as UShort.
+static const int MSG_INTERESTREGION = 0x84;
+/// Server->Client, unreliable: draw commands confirmed since the client's acknowledged baseline, sent instead of MSG_DRAWCONFIRMBATCH
+/// and MSG_DRAWREQUESTACK in baseline delta mode. Lost deltas are not resent, the next one covers them. Payload: DrawDeltaHeader, then a
+/// batch in MSG_DRAWCONFIRMBATCH format.
+static const int MSG_DRAWCONFIRMDELTA = 0x85;
+/// Client->Server, unreliable: acknowledges an applied delta. Payload: sequence number of the next command the client needs, then client
+/// sequence number of the last draw request acknowledged.
+static const int MSG_DRAWDELTAACK = 0x86;
+
+/// Maximum number of draw commands packed into a single batch message.
+static const unsigned MAX_DRAWCOMMANDS_PER_BATCH = 1024;
+/// Maximum number of draw commands packed into a single delta message, so that it fits a datagram without fragmentation.
+static const unsigned MAX_DRAWCOMMANDS_PER_DELTA = 128;
+/// Number of commands after which the server recompresses the table snapshot for joining clients.
+static const unsigned SNAPSHOT_REFRESH_COMMANDS = 256;
@@ -0,0 +1,77 @@
+#include <cstring>
+
+#include "DeltaCache.h"
+
+DeltaCache::DeltaCache() :
+	size_(0)
+{
+	memset(slots_, 0, sizeof slots_);
+}
+
+bool DeltaCache::Store(unsigned base, unsigned end, const void* data, unsigned size)
+{
+	unsigned slot = GetSlot(base);
+	while (slots_[slot].data_ && slots_[slot].base_ != base)
+		slot = (slot + 1) & (DELTACACHE_NUM_SLOTS - 1);
+
+	// A resend with the same base covers at least as much as the held delta
+	PendingDelta& delta = slots_[slot];
+	if (!delta.data_)
+	{
+		if (size_ >= MAX_PENDING_DELTAS)
+			return false;
+		++size_;
+	}
+	delta.base_ = base;
+	delta.end_ = end;
+	delta.data_ = arena_.Store(data, size);
+	delta.size_ = size;
+	return true;
+}
+
+const PendingDelta* DeltaCache::FindCovering(unsigned sequence)
+{
+	// Erasing moves deltas into the emptied slot, so look at it again
+	for (unsigned slot = 0; slot < DELTACACHE_NUM_SLOTS && size_;)
+	{
+		if (slots_[slot].data_ && slots_[slot].end_ <= sequence)
+			Erase(slot);
+		else
+			++slot;
+	}
+
+	const PendingDelta* best = 0;
+	for (unsigned slot = 0; slot < DELTACACHE_NUM_SLOTS && size_; ++slot)
+	{
+		const PendingDelta& delta = slots_[slot];
+		if (delta.data_ && delta.base_ <= sequence && delta.end_ > sequence && (!best || delta.end_ > best->end_))
+			best = &delta;
+	}
+	return best;
+}
+
+void DeltaCache::Reset()
+{
+	if (size_)
+		memset(slots_, 0, sizeof slots_);
+	size_ = 0;
+	arena_.Reset();
+}
+
+void DeltaCache::Erase(unsigned slot)
+{
+	slots_[slot].data_ = 0;
+	--size_;
+
+	for (unsigned next = (slot + 1) & (DELTACACHE_NUM_SLOTS - 1); slots_[next].data_; next = (next + 1) & (DELTACACHE_NUM_SLOTS - 1))
+	{
+		// A delta stays unless the hole lies on its probe sequence, between its home slot and its own
+		unsigned home = GetSlot(slots_[next].base_);
+		bool reachable = slot <= next ? (home > slot && home <= next) : (home > slot || home <= next);
+		if (reachable)
+			continue;
+		slots_[slot] = slots_[next];
+		slots_[next].data_ = 0;
+		slot = next;
+	}
+}
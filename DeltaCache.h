@@ -0,0 +1,60 @@
+#pragma once
+
+#include "ByteArena.h"
+
+/// Maximum number of deltas held back at once. Further ones are dropped, the server resends them anyway.
+static const unsigned MAX_PENDING_DELTAS = 64;
+/// Slots in the delta lookup table, a power of two twice the maximum number of deltas so that probes stay short.
+static const unsigned DELTACACHE_NUM_SLOTS = 2 * MAX_PENDING_DELTAS;
+
+/// Delta message held back until what it builds on has arrived.
+struct PendingDelta
+{
+	/// Base sequence number of the delta.
+	unsigned base_;
+	/// Sequence number after the last command the delta covers.
+	unsigned end_;
+	/// Message bytes, null for an empty slot.
+	const unsigned char* data_;
+	/// Message size in bytes.
+	unsigned size_;
+};
+
+/// Client side store of deltas that arrived before the commands or bands they build on, so that reordering does not cost a
+/// resend. Message bytes are copied into an arena and found by base sequence number in an open-addressed table. Both are
+/// reset once per network update; whatever could not be applied by then is covered by the server's next delta.
+class DeltaCache
+{
+public:
+	/// Construct empty.
+	DeltaCache();
+
+	/// Store delta message covering [base, end) under its base sequence number, replacing an older one with the same base.
+	/// Return false if full.
+	bool Store(unsigned base, unsigned end, const void* data, unsigned size);
+	/// Forget deltas ending at or before sequence number, and return the one reaching furthest of those covering it, or null
+	/// if none.
+	const PendingDelta* FindCovering(unsigned sequence);
+	/// Forget all deltas.
+	void Reset();
+
+	/// Return number of deltas held.
+	unsigned GetSize() const { return size_; }
+	/// Return bytes of the deltas held.
+	unsigned GetBytes() const { return arena_.GetUsed(); }
+	/// Return number of arena chunks allocated.
+	unsigned GetArenaChunks() const { return arena_.GetNumChunks(); }
+
+private:
+	/// Return home slot of base sequence number.
+	static unsigned GetSlot(unsigned base) { return (base * 2654435761U) & (DELTACACHE_NUM_SLOTS - 1); }
+	/// Empty slot and move later deltas of its probe sequence back, so that lookups need no tombstones.
+	void Erase(unsigned slot);
+
+	/// Lookup table with linear probing.
+	PendingDelta slots_[DELTACACHE_NUM_SLOTS];
+	/// Storage of the message bytes.
+	ByteArena arena_;
+	/// Number of deltas held.
+	unsigned size_;
+};
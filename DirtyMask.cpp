@@ -0,0 +1,94 @@
+#include <Urho3D/Math/MathDefs.h>
+
+#include "DirtyMask.h"
+
+#include <cstring>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+static unsigned CountTrailingZeros(unsigned long long value)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+	unsigned long index;
+	_BitScanForward64(&index, value);
+	return index;
+#elif defined(_MSC_VER)
+	unsigned long index;
+	if (_BitScanForward(&index, (unsigned long)value))
+		return index;
+	_BitScanForward(&index, (unsigned long)(value >> 32));
+	return index + 32;
+#else
+	return (unsigned)__builtin_ctzll(value);
+#endif
+}
+
+static unsigned CountSetBits(unsigned long long value)
+{
+#ifdef _MSC_VER
+	// Without relying on the POPCNT instruction being available
+	value -= (value >> 1) & 0x5555555555555555ULL;
+	value = (value & 0x3333333333333333ULL) + ((value >> 2) & 0x3333333333333333ULL);
+	value = (value + (value >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+	return (unsigned)((value * 0x0101010101010101ULL) >> 56);
+#else
+	return (unsigned)__builtin_popcountll(value);
+#endif
+}
+
+void DirtyMask::Resize(unsigned numBits)
+{
+	unsigned oldSize = words_.Size();
+	unsigned newSize = (numBits + DIRTYMASK_WORD_BITS - 1) / DIRTYMASK_WORD_BITS;
+	words_.Resize(newSize);
+	if (newSize > oldSize)
+		memset(&words_[oldSize], 0, (newSize - oldSize) * sizeof(unsigned long long));
+}
+
+void DirtyMask::ClearAll()
+{
+	if (words_.Size())
+		memset(&words_[0], 0, words_.Size() * sizeof(unsigned long long));
+}
+
+void DirtyMask::Merge(const DirtyMask& other)
+{
+	unsigned size = Min(words_.Size(), other.words_.Size());
+	for (unsigned i = 0; i < size; ++i)
+		words_[i] |= other.words_[i];
+}
+
+unsigned DirtyMask::FindNext(unsigned start) const
+{
+	unsigned i = start / DIRTYMASK_WORD_BITS;
+	if (i >= words_.Size())
+		return M_MAX_UNSIGNED;
+
+	// Bits below start are masked off in the first word only
+	unsigned long long word = words_[i] & (~0ULL << (start % DIRTYMASK_WORD_BITS));
+	while (!word)
+	{
+		if (++i == words_.Size())
+			return M_MAX_UNSIGNED;
+		word = words_[i];
+	}
+	return i * DIRTYMASK_WORD_BITS + CountTrailingZeros(word);
+}
+
+unsigned DirtyMask::Count() const
+{
+	unsigned count = 0;
+	for (unsigned i = 0; i < words_.Size(); ++i)
+		count += CountSetBits(words_[i]);
+	return count;
+}
+
+bool DirtyMask::Any() const
+{
+	unsigned long long any = 0;
+	for (unsigned i = 0; i < words_.Size(); ++i)
+		any |= words_[i];
+	return any != 0;
+}
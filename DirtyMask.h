@@ -0,0 +1,54 @@
+#pragma once
+
+#include <Urho3D/Container/Vector.h>
+
+using namespace Urho3D;
+
+/// Bits per DirtyMask word.
+static const unsigned DIRTYMASK_WORD_BITS = 64;
+
+/// Growable bit set stored in 64-bit words. Setting, clearing and merging are branch-free word operations; set bits are
+/// counted with popcount and visited in ascending order by counting trailing zeros, skipping empty words whole.
+class DirtyMask
+{
+public:
+	/// Construct empty.
+	DirtyMask() {}
+	/// Construct with all of numBits cleared.
+	DirtyMask(unsigned numBits) { Resize(numBits); }
+
+	/// Set capacity in bits. New bits are cleared.
+	void Resize(unsigned numBits);
+	/// Set bit.
+	void Set(unsigned index) { words_[index / DIRTYMASK_WORD_BITS] |= Bit(index); }
+	/// Set or clear bit without branching on the value.
+	void Set(unsigned index, bool value)
+	{
+		unsigned long long& word = words_[index / DIRTYMASK_WORD_BITS];
+		word = (word & ~Bit(index)) | ((0ULL - (unsigned long long)value) & Bit(index));
+	}
+	/// Clear bit.
+	void Clear(unsigned index) { words_[index / DIRTYMASK_WORD_BITS] &= ~Bit(index); }
+	/// Clear all bits.
+	void ClearAll();
+	/// Set every bit that is set in other. Bits beyond the capacity are ignored.
+	void Merge(const DirtyMask& other);
+	/// Return index of the first set bit at or after start, or M_MAX_UNSIGNED if none.
+	unsigned FindNext(unsigned start) const;
+
+	/// Return whether bit is set.
+	bool IsSet(unsigned index) const { return (words_[index / DIRTYMASK_WORD_BITS] & Bit(index)) != 0; }
+	/// Return number of set bits.
+	unsigned Count() const;
+	/// Return whether any bit is set.
+	bool Any() const;
+	/// Return capacity in bits, rounded up to whole words.
+	unsigned GetSize() const { return words_.Size() * DIRTYMASK_WORD_BITS; }
+
+private:
+	/// Return mask of bit within its word.
+	static unsigned long long Bit(unsigned index) { return 1ULL << (index % DIRTYMASK_WORD_BITS); }
+
+	/// Bit words, lowest index in the least significant bit of the first word.
+	PODVector<unsigned long long> words_;
+};
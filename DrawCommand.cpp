@@ -0,0 +1,179 @@
+#include <Urho3D/IO/Deserializer.h>
+#include <Urho3D/IO/Serializer.h>
+#include <Urho3D/Math/MathDefs.h>
+#include <Urho3D/Urho2D/Drawable2D.h>
+
+#include <cmath>
+
+#include "Common.h"
+#include "DrawCommand.h"
+#include "DrawHistory.h"
+
+// Table coordinates in pixels, with y growing upwards like world coordinates
+static const QuantizedRange POSITION_RANGE(0.0f, (float)DRAWING_TABLE_SIZE, DRAWCOMMAND_POSITION_BITS);
+static const QuantizedRange CHANNEL_RANGE(0.0f, 1.0f, DRAWCOMMAND_COLOR_BITS);
+
+static float WorldToCoord(float world)
+{
+	return world / PIXEL_SIZE + DRAWING_TABLE_SIZE / 2.0f;
+}
+
+static float CoordToWorld(float coord)
+{
+	return (coord - DRAWING_TABLE_SIZE / 2.0f) * PIXEL_SIZE;
+}
+
+Vector2 WorldToTable(const Vector2& position)
+{
+	float halfExtent = DRAWING_TABLE_SIZE * PIXEL_SIZE / 2.0f;
+	return Vector2((position.x_ + halfExtent) / PIXEL_SIZE, DRAWING_TABLE_SIZE - (position.y_ + halfExtent) / PIXEL_SIZE);
+}
+
+bool IsOnTable(const Vector2& position)
+{
+	float halfExtent = DRAWING_TABLE_SIZE * PIXEL_SIZE / 2.0f;
+	return Abs(position.x_) <= halfExtent && Abs(position.y_) <= halfExtent;
+}
+
+void WriteDrawPosition(BitWriter& dest, const Vector2& position)
+{
+	dest.WriteQuantized(WorldToCoord(position.x_), POSITION_RANGE);
+	dest.WriteQuantized(WorldToCoord(position.y_), POSITION_RANGE);
+}
+
+Vector2 ReadDrawPosition(BitReader& source)
+{
+	float x = CoordToWorld(source.ReadQuantized(POSITION_RANGE));
+	float y = CoordToWorld(source.ReadQuantized(POSITION_RANGE));
+	return Vector2(x, y);
+}
+
+Vector2 QuantizeDrawPosition(const Vector2& position)
+{
+	float x = CoordToWorld(POSITION_RANGE.Round(WorldToCoord(position.x_)));
+	float y = CoordToWorld(POSITION_RANGE.Round(WorldToCoord(position.y_)));
+	return Vector2(x, y);
+}
+
+Color QuantizeDrawColor(const Color& color)
+{
+	return Color(CHANNEL_RANGE.Round(color.r_), CHANNEL_RANGE.Round(color.g_), CHANNEL_RANGE.Round(color.b_));
+}
+
+unsigned PackDrawColor(const Color& color)
+{
+	return CHANNEL_RANGE.Quantize(color.r_) | CHANNEL_RANGE.Quantize(color.g_) << DRAWCOMMAND_COLOR_BITS |
+		CHANNEL_RANGE.Quantize(color.b_) << (2 * DRAWCOMMAND_COLOR_BITS);
+}
+
+Color UnpackDrawColor(unsigned value)
+{
+	unsigned mask = CHANNEL_RANGE.maxValue_;
+	return Color(CHANNEL_RANGE.Dequantize(value & mask), CHANNEL_RANGE.Dequantize((value >> DRAWCOMMAND_COLOR_BITS) & mask),
+		CHANNEL_RANGE.Dequantize((value >> (2 * DRAWCOMMAND_COLOR_BITS)) & mask));
+}
+
+void DrawDeltaHeader::Write(Serializer& dest) const
+{
+	dest.WriteUInt(base_);
+	dest.WriteUInt(end_);
+	dest.WriteVLE(numBands_);
+	dest.WriteUInt(lastRequest_);
+}
+
+void DrawDeltaHeader::Read(Deserializer& source)
+{
+	base_ = source.ReadUInt();
+	end_ = source.ReadUInt();
+	numBands_ = source.ReadVLE();
+	lastRequest_ = source.ReadUInt();
+}
+
+DrawConfirmWriter::DrawConfirmWriter(Serializer& dest, unsigned firstSequence, unsigned firstTick, unsigned count) :
+	bits_(dest),
+	previousColor_(M_MAX_UNSIGNED),
+	previousTick_(firstTick)
+{
+	dest.WriteUInt(firstSequence);
+	dest.WriteUInt(firstTick);
+	dest.WriteVLE(count);
+}
+
+void DrawConfirmWriter::BeginRun(unsigned gap, unsigned length)
+{
+	bits_.WriteVLE(gap);
+	bits_.WriteVLE(length);
+}
+
+void DrawConfirmWriter::Write(const DrawCommand& command)
+{
+	WriteDrawPosition(bits_, command.position);
+
+	// Batches are mostly runs of one painter's clicks
+	unsigned color = PackDrawColor(command.color);
+	bits_.WriteBit(color == previousColor_);
+	if (color != previousColor_)
+		bits_.Write(color, 3 * DRAWCOMMAND_COLOR_BITS);
+	previousColor_ = color;
+
+	// A tick usually applies several commands
+	bits_.WriteBit(command.tick == previousTick_);
+	if (command.tick != previousTick_)
+		bits_.WriteVLE(command.tick - previousTick_ - 1);
+	previousTick_ = command.tick;
+}
+
+void WriteDrawConfirms(Serializer& dest, const DrawHistory& history, const unsigned* sequences, unsigned count,
+	unsigned emptyTick)
+{
+	DrawConfirmWriter writer(dest, count ? sequences[0] : 0, count ? history.Get(sequences[0]).tick : emptyTick, count);
+	unsigned next = count ? sequences[0] : 0;
+	for (unsigned i = 0; i < count;)
+	{
+		unsigned run = 1;
+		while (i + run < count && sequences[i + run] == sequences[i] + run)
+			++run;
+		writer.BeginRun(sequences[i] - next, run);
+		for (unsigned j = i; j < i + run; ++j)
+			writer.Write(history.Get(sequences[j]));
+		next = sequences[i] + run;
+		i += run;
+	}
+	writer.Finish();
+}
+
+DrawConfirmReader::DrawConfirmReader(Deserializer& source) :
+	bits_(source),
+	run_(0),
+	previousColor_(Color::WHITE)
+{
+	sequence_ = source.ReadUInt();
+	previousTick_ = source.ReadUInt();
+	remaining_ = Min(source.ReadVLE(), MAX_DRAWCOMMANDS_PER_BATCH);
+}
+
+bool DrawConfirmReader::Read(DrawCommand& command, unsigned& sequence)
+{
+	while (remaining_ && !run_ && !bits_.IsEof())
+	{
+		sequence_ += bits_.ReadVLE();
+		run_ = Min(bits_.ReadVLE(), remaining_);
+	}
+	if (!remaining_ || !run_ || bits_.IsEof())
+		return false;
+
+	command.position = ReadDrawPosition(bits_);
+	if (!bits_.ReadBit())
+		previousColor_ = UnpackDrawColor(bits_.Read(3 * DRAWCOMMAND_COLOR_BITS));
+	command.color = previousColor_;
+	if (!bits_.ReadBit())
+		previousTick_ += bits_.ReadVLE() + 1;
+	command.tick = previousTick_;
+	if (bits_.IsEof())
+		return false;
+
+	sequence = sequence_++;
+	--remaining_;
+	--run_;
+	return true;
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <Urho3D/Math/Color.h>
+#include <Urho3D/Math/Vector2.h>
+
+#include "BitStream.h"
+
+namespace Urho3D
+{
+
+class Deserializer;
+class Serializer;
+
+}
+
+using namespace Urho3D;
+
+class DrawHistory;
+
+/// Drawing table side in pixels.
+static const int DRAWING_TABLE_SIZE = 512;
+/// Bits per table coordinate on the wire, about 1/16 pixel over the table side.
+static const unsigned DRAWCOMMAND_POSITION_BITS = 13;
+/// Bits per color channel on the wire.
+static const unsigned DRAWCOMMAND_COLOR_BITS = 8;
+/// Bytes to reserve per draw command when building a message. Covers a confirmed command with its color and run header.
+static const unsigned DRAWCOMMAND_RESERVE_SIZE = 8;
+
+struct DrawCommand
+{
+	DrawCommand() : position(Vector2::ZERO), color(Color::RED), tick(0) {}
+	DrawCommand(Vector2 p, Color c, unsigned t = 0) : position(p), color(c), tick(t) {}
+	Vector2 position;
+	Color	color;
+	/// Server tick that applied the command.
+	unsigned tick;
+};
+
+/// Return table pixel coordinates of world position. Rows grow downwards like in the table image.
+Vector2 WorldToTable(const Vector2& position);
+/// Return whether world position lies on the drawing table.
+bool IsOnTable(const Vector2& position);
+/// Write world position as quantized table coordinates. Positions outside the table are clamped to its border.
+void WriteDrawPosition(BitWriter& dest, const Vector2& position);
+/// Read quantized table coordinates and return world position.
+Vector2 ReadDrawPosition(BitReader& source);
+/// Return world position as it arrives after a round trip through WriteDrawPosition and ReadDrawPosition.
+Vector2 QuantizeDrawPosition(const Vector2& position);
+/// Return color as it arrives in a draw command.
+Color QuantizeDrawColor(const Color& color);
+/// Return RGB channels quantized for the wire, red in the lowest bits.
+unsigned PackDrawColor(const Color& color);
+/// Return color of packed channels.
+Color UnpackDrawColor(unsigned value);
+
+/// Header of a draw confirm delta, which covers everything confirmed since the receiver's acknowledged baseline.
+struct DrawDeltaHeader
+{
+	/// Construct empty.
+	DrawDeltaHeader() : base_(0), end_(0), numBands_(0), lastRequest_(0) {}
+
+	/// Write to a message.
+	void Write(Serializer& dest) const;
+	/// Read from a message.
+	void Read(Deserializer& source);
+
+	/// Sequence number the delta starts from. The receiver may apply it only when it has every command before.
+	unsigned base_;
+	/// Sequence number after the last command covered, sent or filtered out.
+	unsigned end_;
+	/// Table snapshot bands sent to the receiver before the delta. The receiver may apply it only when it has them all.
+	unsigned numBands_;
+	/// Client sequence number of the last draw request processed.
+	unsigned lastRequest_;
+};
+
+/// Writes a draw confirm batch: first sequence number, first tick and VLE count, then bit-packed runs of sequence gap, run
+/// length and commands. A command repeating the previous command's color spends one bit on it instead of the color, and
+/// one in the same tick one bit on the tick instead of the step to it.
+class DrawConfirmWriter
+{
+public:
+	/// Construct and write the batch header. Commands must follow in ascending tick order from firstTick on.
+	DrawConfirmWriter(Serializer& dest, unsigned firstSequence, unsigned firstTick, unsigned count);
+
+	/// Begin run of consecutive commands after skipping gap sequence numbers.
+	void BeginRun(unsigned gap, unsigned length);
+	/// Write next command of the run.
+	void Write(const DrawCommand& command);
+	/// Write the partial last byte. Must be called after the last command.
+	void Finish() { bits_.Flush(); }
+
+private:
+	/// Bit stream after the header.
+	BitWriter bits_;
+	/// Quantized color of the previous command, or M_MAX_UNSIGNED before the first.
+	unsigned previousColor_;
+	/// Tick of the previous command.
+	unsigned previousTick_;
+};
+
+/// Write the history commands with the given ascending sequence numbers as a draw confirm batch. Consecutive sequence numbers
+/// form runs, the gaps between them skip commands filtered out for the receiver. An empty batch carries emptyTick.
+void WriteDrawConfirms(Serializer& dest, const DrawHistory& history, const unsigned* sequences, unsigned count,
+	unsigned emptyTick);
+
+/// Reads a draw confirm batch written by DrawConfirmWriter. Gaps skip commands the server filtered out for the receiving connection.
+class DrawConfirmReader
+{
+public:
+	/// Construct and read the batch header.
+	DrawConfirmReader(Deserializer& source);
+
+	/// Read next command with its tick, and its sequence number. Return false at the end of the batch or on malformed data.
+	bool Read(DrawCommand& command, unsigned& sequence);
+
+private:
+	/// Bit stream after the header.
+	BitReader bits_;
+	/// Sequence number of the next command.
+	unsigned sequence_;
+	/// Commands left in the batch.
+	unsigned remaining_;
+	/// Commands left in the current run.
+	unsigned run_;
+	/// Color of the previous command.
+	Color previousColor_;
+	/// Tick of the previous command.
+	unsigned previousTick_;
+};
@@ -0,0 +1,163 @@
+#include <Urho3D/IO/MemoryBuffer.h>
+
+#include "BitStream.h"
+#include "Common.h"
+#include "DrawDecoder.h"
+
+DrawDecoder::DrawDecoder() :
+	jobs_(DECODER_JOB_QUEUE_SIZE),
+	output_(DECODER_OUTPUT_QUEUE_SIZE),
+	numDropped_(0)
+{
+	wakeup_.Create(kNet::EventWaitSignal);
+}
+
+DrawDecoder::~DrawDecoder()
+{
+	Shutdown();
+	wakeup_.Close();
+}
+
+bool DrawDecoder::Start()
+{
+	return IsStarted() || Run();
+}
+
+void DrawDecoder::Shutdown()
+{
+	if (!IsStarted())
+		return;
+
+	shouldRun_ = false;
+	wakeup_.Set();
+	Stop();
+}
+
+void DrawDecoder::Reset()
+{
+	// With the thread stopped the main thread is the only consumer of the job queue
+	Shutdown();
+	while (jobs_.Front())
+		jobs_.PopFront();
+	backlog_.Clear();
+	while (output_.Front())
+		output_.PopFront();
+}
+
+bool DrawDecoder::Submit(unsigned client, const Color& color, long long receivedTime, unsigned admitted, const void* data,
+	unsigned size)
+{
+	// Nothing may overtake the backlog
+	DecodeJob* job = backlog_.Empty() ? jobs_.BeginInsert() : 0;
+	bool queued = job != 0;
+	if (!queued)
+	{
+		if (backlog_.Size() >= DECODER_MAX_BACKLOG)
+		{
+			++numDropped_;
+			return false;
+		}
+		backlog_.Resize(backlog_.Size() + 1);
+		job = &backlog_.Back();
+	}
+
+	job->client_ = client;
+	job->color_ = color;
+	job->receivedTime_ = receivedTime;
+	job->admitted_ = admitted;
+	job->data_.SetData(data, size);
+	if (queued)
+		jobs_.FinishInsert();
+
+	if (IsStarted())
+		wakeup_.Set();
+	else
+		DecodeJobs();
+	return true;
+}
+
+void DrawDecoder::Refill()
+{
+	do
+	{
+		if (!IsStarted())
+			DecodeJobs();
+
+		unsigned moved = 0;
+		DecodeJob* job;
+		while (moved < backlog_.Size() && (job = jobs_.BeginInsert()) != 0)
+		{
+			const DecodeJob& waiting = backlog_[moved++];
+			job->client_ = waiting.client_;
+			job->color_ = waiting.color_;
+			job->receivedTime_ = waiting.receivedTime_;
+			job->admitted_ = waiting.admitted_;
+			job->data_.SetData(waiting.data_.GetData(), waiting.data_.GetSize());
+			jobs_.FinishInsert();
+		}
+		if (!moved)
+			break;
+		backlog_.Erase(0, moved);
+	} while (!IsStarted());
+
+	// Draining made room for output too
+	if (IsStarted())
+		wakeup_.Set();
+}
+
+void DrawDecoder::ThreadFunction()
+{
+	while (shouldRun_)
+	{
+		// Reset before looking at the queues, so whatever is submitted while decoding sets it again and the wait returns
+		// at once
+		wakeup_.Reset();
+		DecodeJobs();
+		wakeup_.Wait(DECODER_WAIT_MSECS);
+	}
+}
+
+void DrawDecoder::DecodeJobs()
+{
+	// A batch is decoded whole, so it never has to stop halfway for lack of output space
+	while (jobs_.Front() && output_.CapacityLeft() > (int)MAX_DRAWCOMMANDS_PER_BATCH)
+	{
+		Decode(*jobs_.Front());
+		jobs_.PopFront();
+	}
+}
+
+void DrawDecoder::Decode(const DecodeJob& job)
+{
+	MemoryBuffer msg(job.data_.GetData(), job.data_.GetSize());
+
+	// Requests past the batch limit or the admitted ones are dropped but still acknowledged, which rolls back their
+	// predictions
+	unsigned first = msg.ReadUInt();
+	unsigned requested = msg.ReadVLE();
+	if (!requested)
+		return;
+
+	DecodedDraw draw;
+	draw.client_ = job.client_;
+	draw.receivedTime_ = job.receivedTime_;
+	draw.lastRequest_ = 0;
+	draw.endOfBatch_ = false;
+
+	BitReader bits(msg);
+	unsigned count = Min(Min(requested, MAX_DRAWCOMMANDS_PER_BATCH), job.admitted_);
+	for (unsigned i = 0; i < count; ++i)
+	{
+		Vector2 position = ReadDrawPosition(bits);
+		if (bits.IsEof())
+			break;
+
+		draw.command_ = DrawCommand(position, job.color_);
+		output_.Insert(draw);
+	}
+
+	draw.command_ = DrawCommand();
+	draw.lastRequest_ = first + requested - 1;
+	draw.endOfBatch_ = true;
+	output_.Insert(draw);
+}
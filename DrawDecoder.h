@@ -0,0 +1,110 @@
+#pragma once
+
+#include <Urho3D/Core/Thread.h>
+#include <Urho3D/IO/VectorBuffer.h>
+
+#include <kNet/Event.h>
+#include <kNet/WaitFreeQueue.h>
+
+#include "DrawCommand.h"
+
+using namespace Urho3D;
+
+/// Request batches that can wait for the decoder thread. A power of two.
+static const unsigned DECODER_JOB_QUEUE_SIZE = 256;
+/// Decoded commands that can wait for the server tick. A power of two.
+static const unsigned DECODER_OUTPUT_QUEUE_SIZE = 16384;
+/// Request batches that can wait in the backlog once the job queue is full. Further ones are dropped.
+static const unsigned DECODER_MAX_BACKLOG = 1024;
+/// Longest the decoder thread sleeps between looks at its queues, in milliseconds.
+static const unsigned long DECODER_WAIT_MSECS = 10;
+
+/// Draw request batch waiting to be decoded.
+struct DecodeJob
+{
+	/// Handle of the sending client.
+	unsigned client_;
+	/// Quantized color of the client's painter.
+	Color color_;
+	/// Time the batch was received in microseconds.
+	long long receivedTime_;
+	/// Requests to decode from the start of the batch. The rest were dropped on arrival.
+	unsigned admitted_;
+	/// Message payload. Queue slots are reused, so its memory is too.
+	VectorBuffer data_;
+};
+
+/// Decoded draw request, or the end of a batch carrying its acknowledgement.
+struct DecodedDraw
+{
+	/// Handle of the sending client.
+	unsigned client_;
+	/// Time the batch was received in microseconds.
+	long long receivedTime_;
+	/// Command, unless this ends a batch.
+	DrawCommand command_;
+	/// Client sequence number of the last request in the batch, if this ends it.
+	unsigned lastRequest_;
+	/// Whether this ends a batch.
+	bool endOfBatch_;
+};
+
+/// Decodes draw request batches on a thread of its own. The main thread submits received payloads and drains the decoded
+/// commands once per server tick, both through kNet wait-free single producer, single consumer queues, so neither side
+/// takes a lock or waits for the other. Batches that find the job queue full wait in a backlog on the main thread, up to
+/// DECODER_MAX_BACKLOG of them. Dropped batches are not acknowledged, but acknowledgements are cumulative, so the sender's
+/// next batch resolves them. Without the thread, batches are decoded on submission and still reach the tick through the
+/// output queue.
+class DrawDecoder : public Thread
+{
+public:
+	/// Construct without starting the thread.
+	DrawDecoder();
+	/// Destruct. Stops the thread.
+	virtual ~DrawDecoder();
+
+	/// Start the decoder thread. Return true on success.
+	bool Start();
+	/// Stop the decoder thread. Undecoded batches are decoded on the main thread from then on.
+	void Shutdown();
+	/// Stop the decoder thread and forget all batches and decoded items. Main thread only.
+	void Reset();
+	/// Queue a received request batch for decoding of its first admitted requests. Return false if dropped for a full
+	/// backlog. Main thread only.
+	bool Submit(unsigned client, const Color& color, long long receivedTime, unsigned admitted, const void* data,
+		unsigned size);
+	/// Return the oldest decoded item, or null if none. Main thread only.
+	const DecodedDraw* GetFront() const { return output_.Front(); }
+	/// Remove the oldest decoded item. Main thread only.
+	void PopFront() { output_.PopFront(); }
+	/// Queue backlogged batches into the space freed by draining. Main thread only.
+	void Refill();
+
+	/// Return number of decoded items waiting.
+	unsigned GetNumDecoded() const { return (unsigned)output_.Size(); }
+	/// Return number of batches waiting to be decoded.
+	unsigned GetNumPending() const { return (unsigned)jobs_.Size() + backlog_.Size(); }
+	/// Return total batches dropped for a full backlog.
+	unsigned GetNumDropped() const { return numDropped_; }
+
+	/// Decode batches until stopped.
+	virtual void ThreadFunction();
+
+private:
+	/// Decode queued batches while the output has room for a whole batch.
+	void DecodeJobs();
+	/// Decode one batch into the output queue.
+	void Decode(const DecodeJob& job);
+
+	/// Batches from the main thread to the decoder.
+	kNet::WaitFreeQueue<DecodeJob> jobs_;
+	/// Decoded commands from the decoder to the main thread.
+	kNet::WaitFreeQueue<DecodedDraw> output_;
+	/// Batches waiting for space in the job queue, in arrival order.
+	Vector<DecodeJob> backlog_;
+	/// Set when there are new batches or new output space. Stays set until the decoder thread resets it, so a wakeup
+	/// while it is busy is not lost.
+	kNet::Event wakeup_;
+	/// Batches dropped.
+	unsigned numDropped_;
+};
@@ -0,0 +1,92 @@
+#include <Urho3D/IO/Log.h>
+
+#include "DrawHistory.h"
+#include "DrawingTable.h"
+
+DrawHistory::DrawHistory(Context* context) :
+	Object(context),
+	begin_(0),
+	end_(0),
+	horizon_(DEFAULT_HISTORY_HORIZON),
+	numCompacted_(0)
+{
+	Reserve(horizon_);
+}
+
+void DrawHistory::SetHorizon(unsigned commands)
+{
+	horizon_ = Max(commands, 1U);
+	Reserve(horizon_);
+}
+
+unsigned DrawHistory::Push(const DrawCommand& command)
+{
+	// Commands not yet allowed to be folded may temporarily exceed the horizon
+	if (GetSize() == ring_.Size())
+		Reserve(ring_.Size() * 2);
+
+	ring_[end_ & (ring_.Size() - 1)] = command;
+	return end_++;
+}
+
+unsigned DrawHistory::Compact(unsigned limit)
+{
+	if (GetSize() <= horizon_)
+		return 0;
+
+	unsigned end = Min(end_ - horizon_, limit);
+	if (end <= begin_)
+		return 0;
+
+	// Only commands leaving the ring are drawn, once each, so the broadcast path does not pay for the keyframe
+	if (!keyframe_)
+		keyframe_ = new DrawingTable(context_);
+	for (unsigned i = begin_; i < end; ++i)
+	{
+		const DrawCommand& dc = Get(i);
+		keyframe_->DrawCircle(dc.position, dc.color);
+	}
+
+	unsigned folded = end - begin_;
+	begin_ = end;
+	numCompacted_ += folded;
+
+	URHO3D_LOGDEBUG(ToString("Folded %u draw commands into keyframe, %u retained, %llu bytes reclaimed in total", folded,
+		GetSize(), GetBytesReclaimed()));
+	return folded;
+}
+
+void DrawHistory::Restart(const DrawingTable* keyframe, unsigned sequence)
+{
+	if (!keyframe_)
+		keyframe_ = new DrawingTable(context_);
+	keyframe_->CopyFrom(*keyframe);
+	begin_ = sequence;
+	end_ = sequence;
+}
+
+void DrawHistory::Replay(DrawingTable* dest, unsigned end) const
+{
+	end = Clamp(end, begin_, end_);
+	if (keyframe_)
+		dest->CopyFrom(*keyframe_);
+	else
+		dest->Clear();
+	for (unsigned i = begin_; i < end; ++i)
+	{
+		const DrawCommand& dc = Get(i);
+		dest->DrawCircle(dc.position, dc.color);
+	}
+}
+
+void DrawHistory::Reserve(unsigned size)
+{
+	unsigned capacity = NextPowerOfTwo(Max(size, 1U));
+	if (capacity <= ring_.Size())
+		return;
+
+	PODVector<DrawCommand> ring(capacity);
+	for (unsigned i = begin_; i != end_; ++i)
+		ring[i & (capacity - 1)] = Get(i);
+	ring_.Swap(ring);
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <Urho3D/Core/Object.h>
+
+#include "DrawCommand.h"
+
+class DrawingTable;
+
+/// Number of recent commands kept individually by default.
+static const unsigned DEFAULT_HISTORY_HORIZON = 4096;
+
+/// Server draw history. Recent commands are kept in a bounded ring for confirms, deltas and replay; older ones are folded into
+/// a keyframe image, so the table can be rebuilt as of any retained sequence number.
+class DrawHistory : public Object
+{
+	URHO3D_OBJECT(DrawHistory, Object);
+
+public:
+	/// Construct empty.
+	DrawHistory(Context* context);
+
+	/// Set number of recent commands to keep individually. Older commands are folded on the next Compact().
+	void SetHorizon(unsigned commands);
+	/// Append command. Return its sequence number.
+	unsigned Push(const DrawCommand& command);
+	/// Fold commands older than the horizon into the keyframe, but none at or after sequence limit. Return number of commands
+	/// folded.
+	unsigned Compact(unsigned limit);
+	/// Drop all commands and continue at sequence number with table as the keyframe.
+	void Restart(const DrawingTable* keyframe, unsigned sequence);
+	/// Rebuild table from the keyframe and retained commands before sequence end.
+	void Replay(DrawingTable* dest, unsigned end) const;
+
+	/// Return retained command by sequence number. Must be in [GetBegin(), GetEnd()).
+	const DrawCommand& Get(unsigned sequence) const { return ring_[sequence & (ring_.Size() - 1)]; }
+	/// Return sequence number of the oldest retained command. Everything before it is in the keyframe.
+	unsigned GetBegin() const { return begin_; }
+	/// Return sequence number the next pushed command will get.
+	unsigned GetEnd() const { return end_; }
+	/// Return number of retained commands.
+	unsigned GetSize() const { return end_ - begin_; }
+	/// Return horizon.
+	unsigned GetHorizon() const { return horizon_; }
+	/// Return keyframe image, or null while nothing has been folded into it and it would be empty.
+	DrawingTable* GetKeyframe() const { return keyframe_; }
+	/// Return total number of commands folded into the keyframe.
+	unsigned GetNumCompacted() const { return numCompacted_; }
+	/// Return bytes that an unbounded history would hold for the folded commands.
+	unsigned long long GetBytesReclaimed() const { return (unsigned long long)numCompacted_ * sizeof(DrawCommand); }
+
+private:
+	/// Grow ring to hold at least the given number of commands.
+	void Reserve(unsigned size);
+
+	/// Ring storage. Size is a power of two.
+	PODVector<DrawCommand> ring_;
+	/// Table with all commands before begin_ applied. Created on the first fold.
+	SharedPtr<DrawingTable> keyframe_;
+	/// Sequence number of the oldest retained command.
+	unsigned begin_;
+	/// Sequence number of the next command.
+	unsigned end_;
+	/// Number of recent commands to keep.
+	unsigned horizon_;
+	/// Total folded commands.
+	unsigned numCompacted_;
+};
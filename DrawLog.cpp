@@ -0,0 +1,482 @@
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/IO/File.h>
+#include <Urho3D/IO/FileSystem.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/IO/MemoryBuffer.h>
+#include <Urho3D/IO/VectorBuffer.h>
+
+#include "DrawLog.h"
+#include "DrawingTable.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const unsigned DRAWLOG_MAGIC = 0x474f4c44; // "DLOG"
+static const unsigned DRAWLOG_INDEX_MAGIC = 0x58444944; // "DIDX"
+static const unsigned DRAWLOG_CHECKPOINT_MAGIC = 0x504b4344; // "DCKP"
+static const unsigned DRAWLOG_VERSION = 1;
+
+/// Log file header, followed by the records.
+struct DrawLogHeader
+{
+	unsigned magic_;
+	unsigned version_;
+	unsigned recordSize_;
+	/// Records committed. Anything after them is left over from a crash and gets overwritten.
+	unsigned numRecords_;
+};
+
+/// Logged command.
+struct DrawLogRecord
+{
+	float x_;
+	float y_;
+	/// Packed quantized color.
+	unsigned color_;
+	unsigned tick_;
+};
+
+static DrawCommand ToDrawCommand(const DrawLogRecord& record)
+{
+	return DrawCommand(Vector2(record.x_, record.y_), UnpackDrawColor(record.color_), record.tick_);
+}
+
+DrawLog::DrawLog(Context* context) :
+	Object(context),
+	readOnly_(false),
+#ifdef _WIN32
+	file_(0),
+	mapping_(0),
+#else
+	fd_(-1),
+#endif
+	data_(0),
+	mappedSize_(0),
+	numRecords_(0),
+	numCommitted_(0),
+	checkpointSequence_(0)
+{
+}
+
+DrawLog::~DrawLog()
+{
+	Close();
+}
+
+bool DrawLog::Open(const String& fileName, bool readOnly)
+{
+	Close();
+	readOnly_ = readOnly;
+	fileName_ = fileName;
+	numRecords_ = 0;
+	numCommitted_ = 0;
+
+#ifdef _WIN32
+	HANDLE file = CreateFileW(WString(GetNativePath(fileName)).CString(), readOnly ? GENERIC_READ : GENERIC_READ |
+		GENERIC_WRITE, FILE_SHARE_READ, 0, readOnly ? OPEN_EXISTING : OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, 0);
+	file_ = file != INVALID_HANDLE_VALUE ? file : 0;
+	bool opened = file_ != 0;
+#else
+	fd_ = open(GetNativePath(fileName).CString(), readOnly ? O_RDONLY : O_RDWR | O_CREAT, 0644);
+	bool opened = fd_ >= 0;
+#endif
+	if (!opened)
+	{
+		URHO3D_LOGERROR("Could not open draw log " + fileName);
+		return false;
+	}
+
+	unsigned long long size = GetFileSize();
+	bool created = size < sizeof(DrawLogHeader);
+	if (created && !readOnly_)
+	{
+		size = sizeof(DrawLogHeader) + (unsigned long long)DRAWLOG_GROW_RECORDS * sizeof(DrawLogRecord);
+		if (!SetFileSize(size))
+			size = 0;
+	}
+	if (size < sizeof(DrawLogHeader) || !Map(size))
+	{
+		URHO3D_LOGERROR("Could not map draw log " + fileName);
+		// Left as it is
+		readOnly_ = true;
+		Close();
+		return false;
+	}
+
+	DrawLogHeader* header = reinterpret_cast<DrawLogHeader*>(data_);
+	if (created)
+	{
+		header->magic_ = DRAWLOG_MAGIC;
+		header->version_ = DRAWLOG_VERSION;
+		header->recordSize_ = sizeof(DrawLogRecord);
+		header->numRecords_ = 0;
+	}
+	else if (header->magic_ != DRAWLOG_MAGIC || header->version_ != DRAWLOG_VERSION ||
+		header->recordSize_ != sizeof(DrawLogRecord))
+	{
+		URHO3D_LOGERROR(fileName + " is not a draw log");
+		readOnly_ = true;
+		Close();
+		return false;
+	}
+	// A log copied while being written may be cut short of its count
+	numRecords_ = (unsigned)Min((unsigned long long)header->numRecords_,
+		(mappedSize_ - sizeof(DrawLogHeader)) / sizeof(DrawLogRecord));
+	numCommitted_ = numRecords_;
+
+	checkpointSequence_ = 0;
+	File checkpoint(context_);
+	if (GetSubsystem<FileSystem>()->FileExists(fileName_ + ".ckpt") && checkpoint.Open(fileName_ + ".ckpt") &&
+		checkpoint.ReadUInt() == DRAWLOG_CHECKPOINT_MAGIC)
+		checkpointSequence_ = Min(checkpoint.ReadUInt(), numRecords_);
+
+	LoadIndex();
+
+	URHO3D_LOGINFO(ToString("Opened draw log %s with %u commands", fileName_.CString(), numRecords_));
+	return true;
+}
+
+void DrawLog::Close()
+{
+	if (data_ && !readOnly_)
+	{
+		Commit();
+		Flush();
+	}
+	Unmap();
+
+#ifdef _WIN32
+	if (file_)
+	{
+		// Trimmed to what was committed, so tools see the records by the file size as well
+		if (!readOnly_)
+			SetFileSize(sizeof(DrawLogHeader) + (unsigned long long)numCommitted_ * sizeof(DrawLogRecord));
+		CloseHandle((HANDLE)file_);
+		file_ = 0;
+	}
+#else
+	if (fd_ >= 0)
+	{
+		if (!readOnly_)
+			SetFileSize(sizeof(DrawLogHeader) + (unsigned long long)numCommitted_ * sizeof(DrawLogRecord));
+		close(fd_);
+		fd_ = -1;
+	}
+#endif
+
+	indexFile_.Reset();
+}
+
+void DrawLog::Append(const DrawCommand& command)
+{
+	if (!data_ || readOnly_)
+		return;
+	if (sizeof(DrawLogHeader) + (unsigned long long)(numRecords_ + 1) * sizeof(DrawLogRecord) > mappedSize_ && !Grow())
+		return;
+
+	DrawLogRecord& record = reinterpret_cast<DrawLogRecord*>(data_ + sizeof(DrawLogHeader))[numRecords_];
+	record.x_ = command.position.x_;
+	record.y_ = command.position.y_;
+	record.color_ = PackDrawColor(command.color);
+	record.tick_ = command.tick;
+
+	if (numRecords_ % DRAWLOG_INDEX_INTERVAL == 0)
+	{
+		DrawLogIndexEntry entry;
+		entry.sequence_ = numRecords_;
+		entry.tick_ = command.tick;
+		entry.time_ = Time::GetTimeSinceEpoch();
+		index_.Push(entry);
+		if (indexFile_)
+		{
+			indexFile_->Write(&entry, sizeof entry);
+			indexFile_->Flush();
+		}
+	}
+
+	++numRecords_;
+}
+
+void DrawLog::Commit()
+{
+	// The records are in place before the count covers them
+	if (data_ && !readOnly_)
+	{
+		reinterpret_cast<DrawLogHeader*>(data_)->numRecords_ = numRecords_;
+		numCommitted_ = numRecords_;
+	}
+}
+
+bool DrawLog::WriteCheckpoint(const DrawingTable* table, unsigned tick)
+{
+	if (!data_ || readOnly_)
+		return false;
+
+	// The checkpoint must never be ahead of the records on disk
+	Commit();
+	Flush();
+
+	String fileName = fileName_ + ".ckpt";
+	String tempFileName = fileName + ".tmp";
+	{
+		File file(context_, tempFileName, FILE_WRITE);
+		if (!file.IsOpen())
+			return false;
+
+		file.WriteUInt(DRAWLOG_CHECKPOINT_MAGIC);
+		file.WriteUInt(numRecords_);
+		file.WriteUInt(tick);
+		VectorBuffer band;
+		for (unsigned i = 0; i < NUM_SNAPSHOT_BANDS; ++i)
+		{
+			band.Clear();
+			table->WriteSnapshotBand(band, i * SNAPSHOT_BAND_ROWS, SNAPSHOT_BAND_ROWS);
+			file.WriteBuffer(band.GetBuffer());
+		}
+	}
+
+	// Replaced whole, so a crash leaves one checkpoint or the other. Windows does not rename over an existing file, and
+	// without a checkpoint the restore replays the whole log instead
+	FileSystem* fileSystem = GetSubsystem<FileSystem>();
+#ifdef _WIN32
+	fileSystem->Delete(fileName);
+#endif
+	if (!fileSystem->Rename(tempFileName, fileName))
+	{
+		URHO3D_LOGERROR("Could not write draw log checkpoint " + fileName);
+		return false;
+	}
+
+	checkpointSequence_ = numRecords_;
+	URHO3D_LOGDEBUG(ToString("Draw log checkpoint at %u commands, tick %u", numRecords_, tick));
+	return true;
+}
+
+bool DrawLog::Restore(DrawingTable* dest, unsigned& tick) const
+{
+	if (!data_)
+		return false;
+
+	unsigned start = LoadCheckpoint(dest, tick);
+	const DrawLogRecord* records = reinterpret_cast<const DrawLogRecord*>(data_ + sizeof(DrawLogHeader));
+	for (unsigned i = start; i < numRecords_; ++i)
+		dest->DrawCircle(Vector2(records[i].x_, records[i].y_), UnpackDrawColor(records[i].color_));
+	if (numRecords_ > start)
+		tick = Max(tick, records[numRecords_ - 1].tick_ + 1);
+
+	URHO3D_LOGINFO(ToString("Restored %u draw commands from %s, %u replayed after the checkpoint", numRecords_,
+		fileName_.CString(), numRecords_ - start));
+	return true;
+}
+
+bool DrawLog::Read(unsigned sequence, DrawCommand& dest) const
+{
+	if (!data_ || sequence >= numRecords_)
+		return false;
+
+	dest = ToDrawCommand(reinterpret_cast<const DrawLogRecord*>(data_ + sizeof(DrawLogHeader))[sequence]);
+	return true;
+}
+
+unsigned DrawLog::FindTick(unsigned tick) const
+{
+	if (!data_)
+		return 0;
+
+	// Ticks never decrease along the log, restarts resume after the last one logged
+	const DrawLogRecord* records = reinterpret_cast<const DrawLogRecord*>(data_ + sizeof(DrawLogHeader));
+	unsigned first = 0;
+	unsigned last = numRecords_;
+	while (first < last)
+	{
+		unsigned middle = first + (last - first) / 2;
+		if (records[middle].tick_ < tick)
+			first = middle + 1;
+		else
+			last = middle;
+	}
+	return first;
+}
+
+unsigned DrawLog::FindTime(unsigned time) const
+{
+	// From the last entry taken before the time, as commands up to the next entry may be later
+	unsigned first = 0;
+	unsigned last = index_.Size();
+	while (first < last)
+	{
+		unsigned middle = first + (last - first) / 2;
+		if (index_[middle].time_ < time)
+			first = middle + 1;
+		else
+			last = middle;
+	}
+	return first ? index_[first - 1].sequence_ : 0;
+}
+
+void DrawLog::LoadIndex()
+{
+	index_.Clear();
+	indexFile_.Reset();
+
+	String fileName = fileName_ + ".idx";
+	if (GetSubsystem<FileSystem>()->FileExists(fileName))
+	{
+		File file(context_, fileName);
+		if (file.IsOpen() && file.ReadUInt() == DRAWLOG_INDEX_MAGIC)
+		{
+			DrawLogIndexEntry entry;
+			while (file.Read(&entry, sizeof entry) == sizeof entry && entry.sequence_ < numRecords_)
+				index_.Push(entry);
+		}
+	}
+
+	if (readOnly_)
+		return;
+
+	// Rewritten without entries left over from a crash, then appended to
+	indexFile_ = new File(context_, fileName, FILE_WRITE);
+	if (!indexFile_->IsOpen())
+	{
+		indexFile_.Reset();
+		return;
+	}
+	indexFile_->WriteUInt(DRAWLOG_INDEX_MAGIC);
+	if (!index_.Empty())
+		indexFile_->Write(&index_[0], index_.Size() * sizeof(DrawLogIndexEntry));
+	indexFile_->Flush();
+}
+
+unsigned DrawLog::LoadCheckpoint(DrawingTable* dest, unsigned& tick) const
+{
+	dest->Clear();
+	tick = 0;
+
+	String fileName = fileName_ + ".ckpt";
+	if (!GetSubsystem<FileSystem>()->FileExists(fileName))
+		return 0;
+	File file(context_, fileName);
+	if (!file.IsOpen() || file.ReadUInt() != DRAWLOG_CHECKPOINT_MAGIC)
+		return 0;
+
+	unsigned sequence = file.ReadUInt();
+	unsigned checkpointTick = file.ReadUInt();
+	if (sequence > numRecords_)
+	{
+		URHO3D_LOGWARNING("Draw log checkpoint is ahead of the log, replaying the whole log");
+		return 0;
+	}
+
+	for (unsigned i = 0; i < NUM_SNAPSHOT_BANDS; ++i)
+	{
+		PODVector<unsigned char> data = file.ReadBuffer();
+		MemoryBuffer band(data);
+		if (dest->ReadSnapshotBand(band) == IntRect::ZERO)
+		{
+			URHO3D_LOGWARNING("Malformed draw log checkpoint, replaying the whole log");
+			dest->Clear();
+			return 0;
+		}
+	}
+
+	tick = checkpointTick;
+	return sequence;
+}
+
+bool DrawLog::Grow()
+{
+	unsigned long long size = mappedSize_ + (unsigned long long)DRAWLOG_GROW_RECORDS * sizeof(DrawLogRecord);
+	// Grows mid-tick, so the count stays as committed. Closing after a failure trims the file to it and drops the
+	// uncommitted records of the tick together
+	Flush();
+	Unmap();
+	if (SetFileSize(size) && Map(size))
+		return true;
+
+	URHO3D_LOGERROR("Could not grow draw log " + fileName_ + ", closing it");
+	Close();
+	return false;
+}
+
+bool DrawLog::Map(unsigned long long size)
+{
+#ifdef _WIN32
+	mapping_ = CreateFileMappingW((HANDLE)file_, 0, readOnly_ ? PAGE_READONLY : PAGE_READWRITE, (DWORD)(size >> 32),
+		(DWORD)size, 0);
+	if (!mapping_)
+		return false;
+	data_ = (unsigned char*)MapViewOfFile((HANDLE)mapping_, readOnly_ ? FILE_MAP_READ : FILE_MAP_WRITE, 0, 0, (SIZE_T)size);
+	if (!data_)
+	{
+		CloseHandle((HANDLE)mapping_);
+		mapping_ = 0;
+		return false;
+	}
+#else
+	void* data = mmap(0, (size_t)size, readOnly_ ? PROT_READ : PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+	if (data == MAP_FAILED)
+		return false;
+	data_ = (unsigned char*)data;
+#endif
+
+	mappedSize_ = size;
+	return true;
+}
+
+void DrawLog::Unmap()
+{
+	if (!data_)
+		return;
+
+#ifdef _WIN32
+	UnmapViewOfFile(data_);
+	CloseHandle((HANDLE)mapping_);
+	mapping_ = 0;
+#else
+	munmap(data_, (size_t)mappedSize_);
+#endif
+
+	data_ = 0;
+	mappedSize_ = 0;
+}
+
+void DrawLog::Flush()
+{
+	if (!data_)
+		return;
+
+#ifdef _WIN32
+	FlushViewOfFile(data_, 0);
+	FlushFileBuffers((HANDLE)file_);
+#else
+	msync(data_, (size_t)mappedSize_, MS_SYNC);
+#endif
+}
+
+unsigned long long DrawLog::GetFileSize() const
+{
+#ifdef _WIN32
+	LARGE_INTEGER size;
+	return GetFileSizeEx((HANDLE)file_, &size) ? (unsigned long long)size.QuadPart : 0;
+#else
+	struct stat status;
+	return fstat(fd_, &status) == 0 ? (unsigned long long)status.st_size : 0;
+#endif
+}
+
+bool DrawLog::SetFileSize(unsigned long long size)
+{
+#ifdef _WIN32
+	LARGE_INTEGER position;
+	position.QuadPart = (LONGLONG)size;
+	return SetFilePointerEx((HANDLE)file_, position, 0, FILE_BEGIN) && SetEndOfFile((HANDLE)file_);
+#else
+	return ftruncate(fd_, (off_t)size) == 0;
+#endif
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <Urho3D/Core/Object.h>
+
+#include "DrawCommand.h"
+
+namespace Urho3D
+{
+
+class File;
+
+}
+
+class DrawingTable;
+
+/// Records the log file grows by at once.
+static const unsigned DRAWLOG_GROW_RECORDS = 65536;
+/// Records between sparse index entries.
+static const unsigned DRAWLOG_INDEX_INTERVAL = 1024;
+/// Records between table checkpoints.
+static const unsigned DRAWLOG_CHECKPOINT_RECORDS = 65536;
+
+/// Sparse index entry, taken when the record at its sequence number was appended.
+struct DrawLogIndexEntry
+{
+	/// Sequence number of the record.
+	unsigned sequence_;
+	/// Server tick of the record.
+	unsigned tick_;
+	/// Wall clock time in seconds since the epoch.
+	unsigned time_;
+};
+
+/// Append-only log of confirmed draw commands, written through a memory-mapped file. Records have a fixed size, so a
+/// command is found by sequence number without reading anything before it. Next to the log, <file>.idx holds a sparse
+/// index by time and <file>.ckpt the table as of the latest checkpoint, from which a restart replays only the records
+/// after it.
+class DrawLog : public Object
+{
+	URHO3D_OBJECT(DrawLog, Object);
+
+public:
+	/// Construct closed.
+	DrawLog(Context* context);
+	/// Destruct. Close the log.
+	virtual ~DrawLog();
+
+	/// Open or create a log for appending, or open an existing one read-only for inspection. Return true if successful.
+	bool Open(const String& fileName, bool readOnly = false);
+	/// Commit and close the log. If the log failed to grow, only what was committed before is kept.
+	void Close();
+	/// Append command. It is recovered after a crash only once committed. Closes the log if it can not grow.
+	void Append(const DrawCommand& command);
+	/// Commit the commands appended so far.
+	void Commit();
+	/// Commit, flush the log to disk and replace the checkpoint with the table as of now. The tick is the one to resume at.
+	/// Return true if successful.
+	bool WriteCheckpoint(const DrawingTable* table, unsigned tick);
+	/// Rebuild the table from the latest checkpoint and the committed records after it, and return the tick to resume at.
+	/// Return true if successful.
+	bool Restore(DrawingTable* dest, unsigned& tick) const;
+
+	/// Read committed command by sequence number. Return true if successful.
+	bool Read(unsigned sequence, DrawCommand& dest) const;
+	/// Return sequence number of the first committed command applied at or after tick, or the number of records if none.
+	unsigned FindTick(unsigned tick) const;
+	/// Return sequence number to read from to see every command logged at or after a time in seconds since the epoch.
+	/// As exact as the sparse index.
+	unsigned FindTime(unsigned time) const;
+
+	/// Return whether the log is open.
+	bool IsOpen() const { return data_ != 0; }
+	/// Return whether enough records were committed since the checkpoint to take the next one.
+	bool IsCheckpointDue() const { return numRecords_ - checkpointSequence_ >= DRAWLOG_CHECKPOINT_RECORDS; }
+	/// Return number of records appended.
+	unsigned GetNumRecords() const { return numRecords_; }
+	/// Return sequence number the checkpoint was taken at.
+	unsigned GetCheckpointSequence() const { return checkpointSequence_; }
+	/// Return sparse index.
+	const PODVector<DrawLogIndexEntry>& GetIndex() const { return index_; }
+	/// Return log file name.
+	const String& GetFileName() const { return fileName_; }
+
+private:
+	/// Load the index, dropping entries past the committed records. Reopen it for appending unless read-only.
+	void LoadIndex();
+	/// Load the checkpoint into the table and return the sequence number it was taken at. Clear the table and return
+	/// zero if there is none usable.
+	unsigned LoadCheckpoint(DrawingTable* dest, unsigned& tick) const;
+	/// Grow the file and remap it. Return true if successful.
+	bool Grow();
+	/// Map size bytes of the file. Return true if successful.
+	bool Map(unsigned long long size);
+	/// Unmap the file.
+	void Unmap();
+	/// Flush the mapped file to disk.
+	void Flush();
+	/// Return size of the file in bytes.
+	unsigned long long GetFileSize() const;
+	/// Resize the file. Return true if successful.
+	bool SetFileSize(unsigned long long size);
+
+	/// Log file name.
+	String fileName_;
+	/// Open read-only.
+	bool readOnly_;
+#ifdef _WIN32
+	/// File handle.
+	void* file_;
+	/// File mapping handle.
+	void* mapping_;
+#else
+	/// File descriptor.
+	int fd_;
+#endif
+	/// Mapped file contents, null if closed.
+	unsigned char* data_;
+	/// Mapped bytes.
+	unsigned long long mappedSize_;
+	/// Records appended.
+	unsigned numRecords_;
+	/// Records committed. The file is trimmed to them on closing.
+	unsigned numCommitted_;
+	/// Sequence number of the checkpoint.
+	unsigned checkpointSequence_;
+	/// Sparse index.
+	PODVector<DrawLogIndexEntry> index_;
+	/// Index file appended to (not read-only.)
+	SharedPtr<File> indexFile_;
+};
@@ -0,0 +1,346 @@
+#include <Urho3D/Core/CoreEvents.h>
+#include <Urho3D/Engine/DebugHud.h>
+#include <Urho3D/IO/File.h>
+#include <Urho3D/IO/FileSystem.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/Network/Connection.h>
+
+#include "DrawCommand.h"
+#include "DrawStats.h"
+
+static const char* CSV_HEADER = "time,connection,rtt_ms,bytes_in_per_sec,bytes_out_per_sec,packets_out_per_sec,requests,"
+	"confirm_count,confirm_p50_ms,confirm_p99_ms,confirm_p999_ms,confirm_max_ms,"
+	"queue_count,queue_p50_ms,queue_p99_ms,queue_p999_ms,queue_max_ms,"
+	"handoff_count,handoff_p50_ms,handoff_p99_ms,handoff_max_ms,handoff_decoded,handoff_pending,"
+	"send_queue_depth,send_queued_bytes,send_deferred_bytes,send_dropped_bytes,flush_rate,flush_backoffs,"
+	"history_retained,history_reclaimed_bytes,requests_coalesced,requests_dropped,overloaded,overloads";
+
+/// Client: own requests awaiting confirms per connection above which the oldest are given up.
+static const unsigned MAX_PENDING_REQUESTS = 4096;
+
+static float ToMsec(unsigned usec)
+{
+	return usec / 1000.0f;
+}
+
+ConnectionDrawStats::ConnectionDrawStats() :
+	requests_(0),
+	sendQueueDepth_(0),
+	sendQueuedBytes_(0),
+	sendDeferredBytes_(0),
+	sendDroppedBytes_(0),
+	requestsCoalesced_(0),
+	requestsDropped_(0),
+	flushRate_(0.0f),
+	flushBackoffs_(0)
+{
+}
+
+DrawStats::DrawStats(Context* context) :
+	Object(context),
+	exportJson_(false),
+	exportInterval_(10.0f),
+	exportAcc_(0.0f),
+	handoffDecoded_(0),
+	handoffPending_(0),
+	overloaded_(false),
+	numOverloads_(0),
+	historyRetained_(0),
+	historyReclaimed_(0)
+{
+	SubscribeToEvent(E_UPDATE, URHO3D_HANDLER(DrawStats, HandleUpdate));
+}
+
+DrawStats::~DrawStats()
+{
+	if (exportFile_)
+		exportFile_->Close();
+}
+
+void DrawStats::SetExportFile(const String& fileName)
+{
+	exportFile_.Reset();
+	if (fileName.Empty())
+		return;
+
+	exportJson_ = GetExtension(fileName) == ".json";
+	exportFile_ = new File(context_, fileName, FILE_WRITE);
+	if (!exportFile_->IsOpen())
+	{
+		URHO3D_LOGERROR("Could not open draw statistics file " + fileName);
+		exportFile_.Reset();
+		return;
+	}
+
+	if (!exportJson_)
+		exportFile_->WriteLine(CSV_HEADER);
+}
+
+void DrawStats::SetExportInterval(float seconds)
+{
+	exportInterval_ = Max(seconds, 0.1f);
+}
+
+void DrawStats::RequestSent(Connection* connection, unsigned sequence, const Vector2& position, const Color& color)
+{
+	ConnectionDrawStats& stats = GetOrCreateStats(connection);
+	// Bounded even if acknowledgements stop arriving
+	if (stats.pending_.Size() >= MAX_PENDING_REQUESTS)
+		stats.pending_.Erase(0, stats.pending_.Size() - MAX_PENDING_REQUESTS + 1);
+
+	PendingDrawRequest request;
+	request.sequence_ = sequence;
+	request.position_ = position;
+	request.color_ = PackDrawColor(color);
+	request.time_ = clock_.GetUSec(false);
+	stats.pending_.Push(request);
+	++stats.requests_;
+}
+
+void DrawStats::ConfirmReceived(Connection* connection, const Vector2& position, const Color& color)
+{
+	HashMap<Connection*, ConnectionDrawStats>::Iterator i = connections_.Find(connection);
+	if (i == connections_.End())
+		return;
+
+	// Confirms include other clients' commands, possibly at the same position
+	ConnectionDrawStats& stats = i->second_;
+	unsigned packedColor = PackDrawColor(color);
+	for (unsigned j = 0; j < stats.pending_.Size(); ++j)
+	{
+		if (stats.pending_[j].position_ != position || stats.pending_[j].color_ != packedColor)
+			continue;
+
+		// The server applies each client's requests in order, so older ones still pending never got a confirm
+		stats.confirmLatency_.Record((unsigned)(clock_.GetUSec(false) - stats.pending_[j].time_));
+		stats.pending_.Erase(0, j + 1);
+		return;
+	}
+}
+
+void DrawStats::RequestsAcknowledged(Connection* connection, unsigned lastRequest)
+{
+	HashMap<Connection*, ConnectionDrawStats>::Iterator i = connections_.Find(connection);
+	if (i == connections_.End())
+		return;
+
+	PODVector<PendingDrawRequest>& pending = i->second_.pending_;
+	unsigned acknowledged = 0;
+	while (acknowledged < pending.Size() && pending[acknowledged].sequence_ <= lastRequest)
+		++acknowledged;
+	pending.Erase(0, acknowledged);
+}
+
+void DrawStats::RequestReceived(Connection* connection, long long receivedTime)
+{
+	ConnectionDrawStats& stats = GetOrCreateStats(connection);
+	stats.handoffLatency_.Record((unsigned)(clock_.GetUSec(false) - receivedTime));
+	stats.receivedTimes_.Push(receivedTime);
+	++stats.requests_;
+}
+
+void DrawStats::RequestsBroadcast()
+{
+	long long now = clock_.GetUSec(false);
+	for (HashMap<Connection*, ConnectionDrawStats>::Iterator i = connections_.Begin(); i != connections_.End(); ++i)
+	{
+		ConnectionDrawStats& stats = i->second_;
+		for (unsigned j = 0; j < stats.receivedTimes_.Size(); ++j)
+			stats.queueLatency_.Record((unsigned)(now - stats.receivedTimes_[j]));
+		stats.receivedTimes_.Clear();
+	}
+}
+
+void DrawStats::SendQueueSampled(Connection* connection, unsigned depth, unsigned queuedBytes, unsigned long long deferredBytes,
+	unsigned long long droppedBytes)
+{
+	ConnectionDrawStats& stats = GetOrCreateStats(connection);
+	stats.sendQueueDepth_ = depth;
+	stats.sendQueuedBytes_ = queuedBytes;
+	stats.sendDeferredBytes_ = deferredBytes;
+	stats.sendDroppedBytes_ = droppedBytes;
+}
+
+void DrawStats::HandoffSampled(unsigned numDecoded, unsigned numPending)
+{
+	handoffDecoded_ = numDecoded;
+	handoffPending_ = numPending;
+}
+
+void DrawStats::RequestsDropped(Connection* connection, unsigned count)
+{
+	GetOrCreateStats(connection).requestsDropped_ += count;
+}
+
+void DrawStats::RequestCoalesced(Connection* connection)
+{
+	++GetOrCreateStats(connection).requestsCoalesced_;
+}
+
+void DrawStats::OverloadSampled(bool overloaded, unsigned numOverloads)
+{
+	overloaded_ = overloaded;
+	numOverloads_ = numOverloads;
+}
+
+void DrawStats::HistorySampled(unsigned numRetained, unsigned long long bytesReclaimed)
+{
+	historyRetained_ = numRetained;
+	historyReclaimed_ = bytesReclaimed;
+}
+
+void DrawStats::FlushRateSampled(Connection* connection, float rate, unsigned numBackoffs)
+{
+	ConnectionDrawStats& stats = GetOrCreateStats(connection);
+	stats.flushRate_ = rate;
+	stats.flushBackoffs_ = numBackoffs;
+}
+
+void DrawStats::RemoveConnection(Connection* connection)
+{
+	connections_.Erase(connection);
+}
+
+const ConnectionDrawStats* DrawStats::GetStats(Connection* connection) const
+{
+	HashMap<Connection*, ConnectionDrawStats>::ConstIterator i = connections_.Find(connection);
+	return i != connections_.End() ? &i->second_ : 0;
+}
+
+String DrawStats::GetSummary() const
+{
+	String summary;
+	if (overloaded_)
+		summary += "Server overloaded, draw requests limited\n";
+	if (historyReclaimed_)
+		summary.AppendWithFormat("History %u commands retained, %.1f KB reclaimed\n", historyRetained_,
+			historyReclaimed_ / 1024.0f);
+	for (HashMap<Connection*, ConnectionDrawStats>::ConstIterator i = connections_.Begin(); i != connections_.End(); ++i)
+	{
+		const ConnectionDrawStats& stats = i->second_;
+		if (!stats.connection_)
+			continue;
+
+		// Show whichever side of the measurement this host has
+		const LatencyHistogram& latency = stats.confirmLatency_.GetCount() ? stats.confirmLatency_ : stats.queueLatency_;
+		summary.AppendWithFormat("%s rtt %.0f %s p50 %.1f p99 %.1f p999 %.1f ms", stats.connection_->ToString().CString(),
+			stats.connection_->GetRoundTripTime(), stats.confirmLatency_.GetCount() ? "confirm" : "queue",
+			ToMsec(latency.GetPercentile(0.5f)), ToMsec(latency.GetPercentile(0.99f)), ToMsec(latency.GetPercentile(0.999f)));
+		if (stats.handoffLatency_.GetCount())
+			summary.AppendWithFormat(", handoff p99 %.1f ms", ToMsec(stats.handoffLatency_.GetPercentile(0.99f)));
+		if (stats.requestsCoalesced_ || stats.requestsDropped_)
+			summary.AppendWithFormat(", %u coalesced %u dropped", stats.requestsCoalesced_, stats.requestsDropped_);
+		if (stats.sendQueueDepth_)
+			summary.AppendWithFormat(", %u sends waiting (%.1f KB)", stats.sendQueueDepth_, stats.sendQueuedBytes_ / 1024.0f);
+		if (stats.flushRate_ > 0.0f)
+			summary.AppendWithFormat(", flushing at %.1f Hz", stats.flushRate_);
+		summary += "\n";
+	}
+	return summary;
+}
+
+ConnectionDrawStats& DrawStats::GetOrCreateStats(Connection* connection)
+{
+	ConnectionDrawStats& stats = connections_[connection];
+	if (stats.connection_ != connection)
+	{
+		// New entry, or a new connection reusing the address of a removed one
+		stats = ConnectionDrawStats();
+		stats.connection_ = connection;
+	}
+	return stats;
+}
+
+void DrawStats::HandleUpdate(StringHash eventType, VariantMap& eventData)
+{
+	using namespace Update;
+
+	DebugHud* debugHud = GetSubsystem<DebugHud>();
+	if (debugHud)
+		debugHud->SetAppStats("Draw latency", GetSummary());
+
+	exportAcc_ += eventData[P_TIMESTEP].GetFloat();
+	if (exportAcc_ >= exportInterval_)
+	{
+		Export();
+		exportAcc_ = 0.0f;
+	}
+}
+
+void DrawStats::Export()
+{
+	SendEvent(E_DRAWSTATSEXPORT);
+
+	String timeStamp = Time::GetTimeStamp();
+
+	for (HashMap<Connection*, ConnectionDrawStats>::Iterator i = connections_.Begin(); i != connections_.End();)
+	{
+		ConnectionDrawStats& stats = i->second_;
+		Connection* connection = stats.connection_;
+		if (!connection)
+		{
+			i = connections_.Erase(i);
+			continue;
+		}
+
+		if (exportFile_)
+		{
+			const LatencyHistogram& confirm = stats.confirmLatency_;
+			const LatencyHistogram& queue = stats.queueLatency_;
+			const LatencyHistogram& handoff = stats.handoffLatency_;
+			String line;
+			if (exportJson_)
+			{
+				line.AppendWithFormat("{\"time\":\"%s\",\"connection\":\"%s\",\"rtt_ms\":%.1f,\"bytes_in_per_sec\":%.0f,"
+					"\"bytes_out_per_sec\":%.0f,\"packets_out_per_sec\":%.0f,\"requests\":%u,", timeStamp.CString(),
+					connection->ToString().CString(), connection->GetRoundTripTime(), connection->GetBytesInPerSec(),
+					connection->GetBytesOutPerSec(), connection->GetPacketsOutPerSec(), stats.requests_);
+				line.AppendWithFormat("\"confirm\":{\"count\":%u,\"p50_ms\":%.3f,\"p99_ms\":%.3f,\"p999_ms\":%.3f,\"max_ms\":%.3f},",
+					confirm.GetCount(), ToMsec(confirm.GetPercentile(0.5f)), ToMsec(confirm.GetPercentile(0.99f)),
+					ToMsec(confirm.GetPercentile(0.999f)), ToMsec(confirm.GetMax()));
+				line.AppendWithFormat("\"queue\":{\"count\":%u,\"p50_ms\":%.3f,\"p99_ms\":%.3f,\"p999_ms\":%.3f,\"max_ms\":%.3f},",
+					queue.GetCount(), ToMsec(queue.GetPercentile(0.5f)), ToMsec(queue.GetPercentile(0.99f)),
+					ToMsec(queue.GetPercentile(0.999f)), ToMsec(queue.GetMax()));
+				line.AppendWithFormat("\"handoff\":{\"count\":%u,\"p50_ms\":%.3f,\"p99_ms\":%.3f,\"max_ms\":%.3f,\"decoded\":%u,"
+					"\"pending\":%u},", handoff.GetCount(), ToMsec(handoff.GetPercentile(0.5f)), ToMsec(handoff.GetPercentile(0.99f)),
+					ToMsec(handoff.GetMax()), handoffDecoded_, handoffPending_);
+				line.AppendWithFormat("\"send\":{\"queue_depth\":%u,\"queued_bytes\":%u,\"deferred_bytes\":%llu,"
+					"\"dropped_bytes\":%llu},", stats.sendQueueDepth_, stats.sendQueuedBytes_, stats.sendDeferredBytes_,
+					stats.sendDroppedBytes_);
+				line.AppendWithFormat("\"flush\":{\"rate\":%.1f,\"backoffs\":%u},", stats.flushRate_, stats.flushBackoffs_);
+				line.AppendWithFormat("\"history\":{\"retained\":%u,\"reclaimed_bytes\":%llu},", historyRetained_,
+					historyReclaimed_);
+				line.AppendWithFormat("\"admission\":{\"coalesced\":%u,\"dropped\":%u,\"overloaded\":%s,\"overloads\":%u}}",
+					stats.requestsCoalesced_, stats.requestsDropped_, overloaded_ ? "true" : "false", numOverloads_);
+			}
+			else
+			{
+				line.AppendWithFormat("%s,%s,%.1f,%.0f,%.0f,%.0f,%u,", timeStamp.CString(), connection->ToString().CString(),
+					connection->GetRoundTripTime(), connection->GetBytesInPerSec(), connection->GetBytesOutPerSec(),
+					connection->GetPacketsOutPerSec(), stats.requests_);
+				line.AppendWithFormat("%u,%.3f,%.3f,%.3f,%.3f,", confirm.GetCount(), ToMsec(confirm.GetPercentile(0.5f)),
+					ToMsec(confirm.GetPercentile(0.99f)), ToMsec(confirm.GetPercentile(0.999f)), ToMsec(confirm.GetMax()));
+				line.AppendWithFormat("%u,%.3f,%.3f,%.3f,%.3f,", queue.GetCount(), ToMsec(queue.GetPercentile(0.5f)),
+					ToMsec(queue.GetPercentile(0.99f)), ToMsec(queue.GetPercentile(0.999f)), ToMsec(queue.GetMax()));
+				line.AppendWithFormat("%u,%.3f,%.3f,%.3f,%u,%u,", handoff.GetCount(), ToMsec(handoff.GetPercentile(0.5f)),
+					ToMsec(handoff.GetPercentile(0.99f)), ToMsec(handoff.GetMax()), handoffDecoded_, handoffPending_);
+				line.AppendWithFormat("%u,%u,%llu,%llu,", stats.sendQueueDepth_, stats.sendQueuedBytes_, stats.sendDeferredBytes_,
+					stats.sendDroppedBytes_);
+				line.AppendWithFormat("%.1f,%u,", stats.flushRate_, stats.flushBackoffs_);
+				line.AppendWithFormat("%u,%llu,", historyRetained_, historyReclaimed_);
+				line.AppendWithFormat("%u,%u,%d,%u", stats.requestsCoalesced_, stats.requestsDropped_, overloaded_ ? 1 : 0,
+					numOverloads_);
+			}
+			exportFile_->WriteLine(line);
+		}
+
+		stats.confirmLatency_.Reset();
+		stats.queueLatency_.Reset();
+		stats.handoffLatency_.Reset();
+		stats.requests_ = 0;
+		++i;
+	}
+
+	if (exportFile_)
+		exportFile_->Flush();
+}
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Math/Color.h>
+
+#include "LatencyHistogram.h"
+
+namespace Urho3D
+{
+
+class Connection;
+class File;
+
+}
+
+using namespace Urho3D;
+
+/// Draw statistics are about to be exported and their histograms reset.
+URHO3D_EVENT(E_DRAWSTATSEXPORT, DrawStatsExport)
+{
+}
+
+/// Client: own request waiting for its confirm.
+struct PendingDrawRequest
+{
+	/// Client sequence number.
+	unsigned sequence_;
+	/// Quantized position.
+	Vector2 position_;
+	/// Color the server applies the request with, packed.
+	unsigned color_;
+	/// Send time in microseconds.
+	long long time_;
+};
+
+/// Draw latency statistics of one connection.
+struct ConnectionDrawStats
+{
+	/// Construct.
+	ConnectionDrawStats();
+
+	/// Connection the statistics belong to.
+	WeakPtr<Connection> connection_;
+	/// Client: own requests waiting for their confirm, oldest first.
+	PODVector<PendingDrawRequest> pending_;
+	/// Server: receive times of requests not yet broadcast in microseconds.
+	PODVector<long long> receivedTimes_;
+	/// Client: time from queuing a request to drawing its confirm.
+	LatencyHistogram confirmLatency_;
+	/// Server: time from receiving a request to broadcasting its confirm.
+	LatencyHistogram queueLatency_;
+	/// Server: time from receiving a request batch to taking its commands from the decoder.
+	LatencyHistogram handoffLatency_;
+	/// Requests sent or received since the last export.
+	unsigned requests_;
+	/// Server: messages waiting for send budget.
+	unsigned sendQueueDepth_;
+	/// Server: bytes waiting for send budget.
+	unsigned sendQueuedBytes_;
+	/// Server: total bytes that had to wait for send budget.
+	unsigned long long sendDeferredBytes_;
+	/// Server: total bytes of unreliable messages dropped for lack of send budget.
+	unsigned long long sendDroppedBytes_;
+	/// Server: total requests coalesced with the previous one by admission control.
+	unsigned requestsCoalesced_;
+	/// Server: total requests dropped by admission control or for a full decoder backlog.
+	unsigned requestsDropped_;
+	/// Server: adaptive flush rate in flushes per second, zero if not adaptive.
+	float flushRate_;
+	/// Server: total number of flush rate backoffs.
+	unsigned flushBackoffs_;
+};
+
+/// Instrumentation subsystem for draw commands. Matches requests with confirms per connection, keeps latency histograms,
+/// shows them in the debug HUD and periodically exports them together with the connection statistics.
+class DrawStats : public Object
+{
+	URHO3D_OBJECT(DrawStats, Object);
+
+public:
+	/// Construct.
+	DrawStats(Context* context);
+	/// Destruct.
+	~DrawStats();
+
+	/// Set file to export to. Written as JSON lines if the extension is .json, otherwise as CSV. Empty disables export.
+	void SetExportFile(const String& fileName);
+	/// Set export interval in seconds. Histograms are reset after each export.
+	void SetExportInterval(float seconds);
+
+	/// Client: a request with the given client sequence number was queued for the connection, to be drawn in the color of
+	/// the client's painter.
+	void RequestSent(Connection* connection, unsigned sequence, const Vector2& position, const Color& color);
+	/// Client: a confirmed command arrived through the connection. Matches own requests by position and color, commands
+	/// of other clients are ignored unless they look exactly the same.
+	void ConfirmReceived(Connection* connection, const Vector2& position, const Color& color);
+	/// Client: the server processed own requests up to the given client sequence number. Those not confirmed by now were
+	/// dropped, coalesced or filtered out and will never be.
+	void RequestsAcknowledged(Connection* connection, unsigned lastRequest);
+	/// Server: a request received at the given time came out of the decoder.
+	void RequestReceived(Connection* connection, long long receivedTime);
+	/// Server: everything received so far has been broadcast.
+	void RequestsBroadcast();
+	/// Server: record the state of the connection's send queue after a network update.
+	void SendQueueSampled(Connection* connection, unsigned depth, unsigned queuedBytes, unsigned long long deferredBytes,
+		unsigned long long droppedBytes);
+	/// Server: record decoded commands and undecoded batches waiting at the start of a tick.
+	void HandoffSampled(unsigned numDecoded, unsigned numPending);
+	/// Server: requests of the connection were dropped before being decoded.
+	void RequestsDropped(Connection* connection, unsigned count);
+	/// Server: a request of the connection coalesced with its previous one.
+	void RequestCoalesced(Connection* connection);
+	/// Server: record the overload state.
+	void OverloadSampled(bool overloaded, unsigned numOverloads);
+	/// Server: record the commands retained by the draw history and the bytes its compaction reclaimed in total.
+	void HistorySampled(unsigned numRetained, unsigned long long bytesReclaimed);
+	/// Server: record the connection's adaptive flush rate.
+	void FlushRateSampled(Connection* connection, float rate, unsigned numBackoffs);
+	/// Forget a connection.
+	void RemoveConnection(Connection* connection);
+
+	/// Return statistics of a connection, or null if none recorded.
+	const ConnectionDrawStats* GetStats(Connection* connection) const;
+	/// Return one line summary per connection.
+	String GetSummary() const;
+	/// Return microseconds since the statistics were created, for timestamps passed in.
+	long long GetTime() { return clock_.GetUSec(false); }
+
+private:
+	/// Return statistics of a connection, creating them if necessary.
+	ConnectionDrawStats& GetOrCreateStats(Connection* connection);
+	/// Handle frame update: refresh the debug HUD and export when due.
+	void HandleUpdate(StringHash eventType, VariantMap& eventData);
+	/// Write all connections to the export file and reset histograms.
+	void Export();
+
+	/// Statistics per connection.
+	HashMap<Connection*, ConnectionDrawStats> connections_;
+	/// Export file.
+	SharedPtr<File> exportFile_;
+	/// JSON lines instead of CSV flag.
+	bool exportJson_;
+	/// Export interval in seconds.
+	float exportInterval_;
+	/// Time since the last export in seconds.
+	float exportAcc_;
+	/// Server: decoded commands waiting at the start of the last tick.
+	unsigned handoffDecoded_;
+	/// Server: undecoded batches waiting at the start of the last tick.
+	unsigned handoffPending_;
+	/// Server: overload flag.
+	bool overloaded_;
+	/// Server: number of times overload started.
+	unsigned numOverloads_;
+	/// Server: commands retained by the draw history.
+	unsigned historyRetained_;
+	/// Server: total bytes reclaimed by draw history compaction.
+	unsigned long long historyReclaimed_;
+	/// Clock for timestamps.
+	HiresTimer clock_;
+};
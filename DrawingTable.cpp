@@ -0,0 +1,175 @@
+#include <Urho3D/IO/Compression.h>
+#include <Urho3D/IO/Deserializer.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/IO/Serializer.h>
+#include <Urho3D/IO/VectorBuffer.h>
+#include <Urho3D/Resource/Image.h>
+#include <Urho3D/Urho2D/Drawable2D.h>
+
+#include "CircleRasterizer.h"
+#include "DrawingTable.h"
+
+static const unsigned char TABLE_BACKGROUND = 64;
+static const int TABLE_ROW_SIZE = DRAWING_TABLE_SIZE * DRAWING_TABLE_COMPONENTS;
+
+static IntRect ClipToTable(const IntRect& rect)
+{
+	return IntRect(Max(rect.left_, 0), Max(rect.top_, 0), Min(rect.right_, DRAWING_TABLE_SIZE),
+		Min(rect.bottom_, DRAWING_TABLE_SIZE));
+}
+
+DrawingTable::DrawingTable(Context* context) :
+	Object(context),
+	image_(new Image(context)),
+	dirtyRect_(IntRect::ZERO),
+	dirtyBands_(NUM_SNAPSHOT_BANDS),
+	circleDiameter_(DEFAULT_CIRCLE_DIAMETER),
+	antiAlias_(false)
+{
+	image_->SetSize(DRAWING_TABLE_SIZE, DRAWING_TABLE_SIZE, DRAWING_TABLE_COMPONENTS);
+	Clear();
+}
+
+void DrawingTable::Clear()
+{
+	memset(image_->GetData(), TABLE_BACKGROUND, DRAWING_TABLE_SIZE * TABLE_ROW_SIZE);
+	MarkDirty(IntRect(0, 0, DRAWING_TABLE_SIZE, DRAWING_TABLE_SIZE));
+}
+
+void DrawingTable::CopyFrom(const DrawingTable& other)
+{
+	memcpy(image_->GetData(), other.image_->GetData(), DRAWING_TABLE_SIZE * TABLE_ROW_SIZE);
+	MarkDirty(IntRect(0, 0, DRAWING_TABLE_SIZE, DRAWING_TABLE_SIZE));
+}
+
+void DrawingTable::CopyRect(const DrawingTable& other, const IntRect& rect)
+{
+	IntRect clipped = ClipToTable(rect);
+	int rowSize = clipped.Width() * DRAWING_TABLE_COMPONENTS;
+	if (rowSize <= 0)
+		return;
+
+	for (int y = clipped.top_; y < clipped.bottom_; ++y)
+	{
+		unsigned offset = y * TABLE_ROW_SIZE + clipped.left_ * DRAWING_TABLE_COMPONENTS;
+		memcpy(image_->GetData() + offset, other.image_->GetData() + offset, rowSize);
+	}
+	MarkDirty(clipped);
+}
+
+IntRect DrawingTable::DrawCircle(const Vector2& drawAt, const Color& color)
+{
+	return DrawCircle(drawAt, color, IntRect(0, 0, DRAWING_TABLE_SIZE, DRAWING_TABLE_SIZE));
+}
+
+IntRect DrawingTable::DrawCircle(const Vector2& drawAt, const Color& color, const IntRect& clip)
+{
+	Vector2 center = WorldToTable(drawAt);
+	IntVector2 coord((int)center.x_, (int)center.y_);
+
+	if (coord.x_ <= 0 || coord.x_ > DRAWING_TABLE_SIZE || coord.y_ <= 0 || coord.y_ > DRAWING_TABLE_SIZE)
+		return IntRect::ZERO;
+
+	IntRect clipped = ClipToTable(clip);
+	if (clipped.right_ <= clipped.left_ || clipped.bottom_ <= clipped.top_)
+		return IntRect::ZERO;
+
+	// Rasterize into the clip rectangle only by moving the center instead of the pixels
+	RasterTarget target(image_->GetData() + clipped.top_ * TABLE_ROW_SIZE + clipped.left_ * DRAWING_TABLE_COMPONENTS,
+		clipped.Width(), clipped.Height(), TABLE_ROW_SIZE);
+	IntRect dirty = RasterizeCircle(target, center - Vector2((float)clipped.left_, (float)clipped.top_), (float)circleDiameter_,
+		color, antiAlias_);
+	if (dirty.right_ <= dirty.left_)
+		return IntRect::ZERO;
+
+	dirty.left_ += clipped.left_;
+	dirty.right_ += clipped.left_;
+	dirty.top_ += clipped.top_;
+	dirty.bottom_ += clipped.top_;
+	MarkDirty(dirty);
+	return dirty;
+}
+
+IntRect DrawingTable::GetCircleRect(const Vector2& position) const
+{
+	Vector2 center = WorldToTable(position);
+	float r = circleDiameter_ * 0.5f + 1.0f;
+	return IntRect((int)floorf(center.x_ - r), (int)floorf(center.y_ - r), (int)ceilf(center.x_ + r), (int)ceilf(center.y_ + r));
+}
+
+void DrawingTable::WriteSnapshotBand(Serializer& dest, int firstRow, int numRows) const
+{
+	firstRow = Clamp(firstRow, 0, DRAWING_TABLE_SIZE);
+	numRows = Clamp(numRows, 0, DRAWING_TABLE_SIZE - firstRow);
+
+	VectorBuffer raw(image_->GetData() + firstRow * TABLE_ROW_SIZE, numRows * TABLE_ROW_SIZE);
+	VectorBuffer compressed = CompressVectorBuffer(raw);
+
+	dest.WriteVLE(firstRow);
+	dest.WriteVLE(numRows);
+	dest.Write(compressed.GetData(), compressed.GetSize());
+}
+
+IntRect DrawingTable::ReadSnapshotBand(Deserializer& source)
+{
+	int firstRow = source.ReadVLE();
+	int numRows = source.ReadVLE();
+	if (firstRow < 0 || numRows <= 0 || firstRow + numRows > DRAWING_TABLE_SIZE)
+		return IntRect::ZERO;
+
+	VectorBuffer compressed(source, source.GetSize() - source.GetPosition());
+	VectorBuffer raw = DecompressVectorBuffer(compressed);
+	if (raw.GetSize() != (unsigned)(numRows * TABLE_ROW_SIZE))
+	{
+		URHO3D_LOGERROR("Malformed table snapshot band");
+		return IntRect::ZERO;
+	}
+
+	memcpy(image_->GetData() + firstRow * TABLE_ROW_SIZE, raw.GetData(), raw.GetSize());
+	IntRect band(0, firstRow, DRAWING_TABLE_SIZE, firstRow + numRows);
+	MarkDirty(band);
+	return band;
+}
+
+void DrawingTable::MarkDirty(const IntRect& rect)
+{
+	if (rect.right_ <= rect.left_ || rect.bottom_ <= rect.top_)
+		return;
+
+	int lastBand = Min(rect.bottom_ - 1, DRAWING_TABLE_SIZE - 1) / SNAPSHOT_BAND_ROWS;
+	for (int band = Max(rect.top_, 0) / SNAPSHOT_BAND_ROWS; band <= lastBand; ++band)
+		dirtyBands_.Set(band);
+
+	if (!IsDirty())
+	{
+		dirtyRect_ = rect;
+		return;
+	}
+
+	dirtyRect_.left_ = Min(dirtyRect_.left_, rect.left_);
+	dirtyRect_.top_ = Min(dirtyRect_.top_, rect.top_);
+	dirtyRect_.right_ = Max(dirtyRect_.right_, rect.right_);
+	dirtyRect_.bottom_ = Max(dirtyRect_.bottom_, rect.bottom_);
+}
+
+void DrawingTable::SetCircleDiameter(int diameter)
+{
+	circleDiameter_ = Max(diameter, 1);
+}
+
+void DrawingTable::SetAntiAlias(bool enable)
+{
+	antiAlias_ = enable;
+}
+
+IntRect DrawingTable::TakeDirtyRect()
+{
+	IntRect rect = dirtyRect_;
+	dirtyRect_ = IntRect::ZERO;
+	return rect;
+}
+
+const unsigned char* DrawingTable::GetPixels(int x, int y) const
+{
+	return image_->GetData() + y * TABLE_ROW_SIZE + x * DRAWING_TABLE_COMPONENTS;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Math/Rect.h>
+
+#include "DirtyMask.h"
+#include "DrawCommand.h"
+
+namespace Urho3D
+{
+
+class Deserializer;
+class Image;
+class Serializer;
+
+}
+
+using namespace Urho3D;
+
+/// Bytes per table pixel (RGB888.)
+static const unsigned DRAWING_TABLE_COMPONENTS = 3;
+/// Circle diameter in pixels used unless changed with SetCircleDiameter().
+static const int DEFAULT_CIRCLE_DIAMETER = 10;
+/// Table rows per snapshot message. Each band is compressed separately to keep messages small.
+static const int SNAPSHOT_BAND_ROWS = 32;
+/// Number of snapshot bands covering the table.
+static const unsigned NUM_SNAPSHOT_BANDS = DRAWING_TABLE_SIZE / SNAPSHOT_BAND_ROWS;
+
+/// CPU side image of the drawing table. Authoritative on the server, mirrored by clients from snapshots and confirmed commands.
+class DrawingTable : public Object
+{
+	URHO3D_OBJECT(DrawingTable, Object);
+
+public:
+	/// Construct with a cleared table.
+	DrawingTable(Context* context);
+
+	/// Fill table with background color.
+	void Clear();
+	/// Copy pixels from another table.
+	void CopyFrom(const DrawingTable& other);
+	/// Copy pixels inside rectangle from another table.
+	void CopyRect(const DrawingTable& other, const IntRect& rect);
+	/// Set diameter of drawn circles in pixels. Must match between server and clients.
+	void SetCircleDiameter(int diameter);
+	/// Set whether circle edges are anti-aliased. Must match between server and clients.
+	void SetAntiAlias(bool enable);
+	/// Rasterize circle at world position. Return touched pixel rectangle, or IntRect::ZERO if nothing was drawn.
+	IntRect DrawCircle(const Vector2& position, const Color& color);
+	/// Rasterize circle at world position, touching only pixels inside the clip rectangle.
+	IntRect DrawCircle(const Vector2& position, const Color& color, const IntRect& clip);
+	/// Return conservative pixel rectangle a circle at world position may touch. Not clipped to the table.
+	IntRect GetCircleRect(const Vector2& position) const;
+	/// Write rows [firstRow, firstRow + numRows) LZ4 compressed.
+	void WriteSnapshotBand(Serializer& dest, int firstRow, int numRows) const;
+	/// Read band written by WriteSnapshotBand. Return updated pixel rectangle, or IntRect::ZERO on malformed data.
+	IntRect ReadSnapshotBand(Deserializer& source);
+	/// Add rectangle to the region modified since the last TakeDirtyRect().
+	void MarkDirty(const IntRect& rect);
+	/// Return bounding rectangle of all modifications since the previous call and reset it. IntRect::ZERO if unmodified.
+	IntRect TakeDirtyRect();
+	/// Forget which snapshot bands were modified.
+	void ClearDirtyBands() { dirtyBands_.ClearAll(); }
+
+	/// Return table image.
+	Image* GetImage() const { return image_; }
+	/// Return whether there are modifications not yet taken with TakeDirtyRect().
+	bool IsDirty() const { return dirtyRect_.right_ > dirtyRect_.left_; }
+	/// Return snapshot bands modified since the last ClearDirtyBands(). Tracked separately from the dirty rectangle.
+	const DirtyMask& GetDirtyBands() const { return dirtyBands_; }
+	/// Return diameter of drawn circles in pixels.
+	int GetCircleDiameter() const { return circleDiameter_; }
+	/// Return whether circle edges are anti-aliased.
+	bool GetAntiAlias() const { return antiAlias_; }
+	/// Return pointer to pixel at x, y.
+	const unsigned char* GetPixels(int x, int y) const;
+
+private:
+	/// Table pixels.
+	SharedPtr<Image> image_;
+	/// Bounding rectangle of modifications since the last TakeDirtyRect().
+	IntRect dirtyRect_;
+	/// Snapshot bands modified since the last ClearDirtyBands().
+	DirtyMask dirtyBands_;
+	/// Circle diameter in pixels.
+	int circleDiameter_;
+	/// Anti-aliasing flag.
+	bool antiAlias_;
+};
@@ -0,0 +1,61 @@
+#include <Urho3D/Math/MathDefs.h>
+
+#include "FlushRate.h"
+
+FlushRate::FlushRate() :
+	numBackoffs_(0),
+	congested_(false),
+	changed_(false)
+{
+	SetMaxRate(30.0f);
+}
+
+void FlushRate::SetMaxRate(float rate)
+{
+	maxRate_ = Max(rate, MIN_FLUSH_RATE);
+	rate_ = maxRate_;
+	sinceFlush_ = 0.0f;
+	sinceBackoff_ = 0.0f;
+	minRoundTripTime_ = 0.0f;
+}
+
+bool FlushRate::Update(float timeStep, float roundTripTime, float lossRate, unsigned queueDepth)
+{
+	if (roundTripTime > 0.0f)
+		minRoundTripTime_ = minRoundTripTime_ > 0.0f ? Min(minRoundTripTime_, roundTripTime) : roundTripTime;
+
+	congested_ = lossRate > CONGESTION_LOSS_RATE || queueDepth > CONGESTION_QUEUE_DEPTH ||
+		roundTripTime > minRoundTripTime_ * CONGESTION_RTT_FACTOR + CONGESTION_RTT_MARGIN;
+	changed_ = false;
+	sinceBackoff_ += timeStep;
+
+	if (congested_)
+	{
+		// The link has not yet seen the effect of a decrease until a round trip and a flush later
+		if (sinceBackoff_ >= Max(roundTripTime * 0.001f, 1.0f / rate_) && rate_ > MIN_FLUSH_RATE)
+		{
+			rate_ = Max(rate_ * FLUSH_RATE_DECREASE, MIN_FLUSH_RATE);
+			sinceBackoff_ = 0.0f;
+			++numBackoffs_;
+			changed_ = true;
+		}
+	}
+	else if (rate_ < maxRate_)
+	{
+		rate_ = Min(rate_ + FLUSH_RATE_INCREASE * timeStep, maxRate_);
+		changed_ = rate_ == maxRate_;
+	}
+
+	// At the full rate every update flushes. Below it the remainder carries over, so the average interval is exact
+	if (rate_ >= maxRate_)
+	{
+		sinceFlush_ = 0.0f;
+		return true;
+	}
+	float interval = 1.0f / rate_;
+	sinceFlush_ += timeStep;
+	if (sinceFlush_ < interval)
+		return false;
+	sinceFlush_ = Min(sinceFlush_ - interval, interval);
+	return true;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <Urho3D/Core/Object.h>
+
+using namespace Urho3D;
+
+/// Adaptive flush rate of a client backed off for congestion or recovered to the full update rate.
+URHO3D_EVENT(E_CLIENTFLUSHRATE, ClientFlushRate)
+{
+	URHO3D_PARAM(P_CONNECTION, Connection);	// Connection pointer
+	URHO3D_PARAM(P_RATE, Rate);				// float, flushes per second
+	URHO3D_PARAM(P_CONGESTED, Congested);	// bool
+}
+
+/// Lowest adaptive flush rate in flushes per second.
+static const float MIN_FLUSH_RATE = 2.0f;
+/// Flushes per second added each second while the link is healthy.
+static const float FLUSH_RATE_INCREASE = 10.0f;
+/// Factor the flush rate is multiplied with on congestion.
+static const float FLUSH_RATE_DECREASE = 0.5f;
+/// Packet loss rate above which a link counts as congested.
+static const float CONGESTION_LOSS_RATE = 0.05f;
+/// Factor over the lowest round trip time seen above which a link counts as congested.
+static const float CONGESTION_RTT_FACTOR = 2.0f;
+/// Round trip time in milliseconds a link may add to CONGESTION_RTT_FACTOR times its lowest before it counts as congested.
+static const float CONGESTION_RTT_MARGIN = 50.0f;
+/// Messages waiting in the outbound queue above which a link counts as congested.
+static const unsigned CONGESTION_QUEUE_DEPTH = 64;
+
+/// Additive increase, multiplicative decrease rate at which one connection is flushed. Backs off when the link shows
+/// congestion through round trip time growth, packet loss or a backed up outbound queue, at most once per round trip so a
+/// decrease can take effect before the next, and creeps back up to the network update rate while the link stays healthy.
+class FlushRate
+{
+public:
+	/// Construct at the default network update rate.
+	FlushRate();
+
+	/// Set the highest rate, normally the network update rate. Restarts at that rate.
+	void SetMaxRate(float rate);
+	/// Adjust the rate to the link statistics and advance time. Round trip time is in milliseconds. Return whether the
+	/// connection is due a flush.
+	bool Update(float timeStep, float roundTripTime, float lossRate, unsigned queueDepth);
+
+	/// Return current rate in flushes per second.
+	float GetRate() const { return rate_; }
+	/// Return highest rate.
+	float GetMaxRate() const { return maxRate_; }
+	/// Return whether the link was congested on the last update.
+	bool IsCongested() const { return congested_; }
+	/// Return whether the last update backed off or reached the highest rate again.
+	bool IsRateChanged() const { return changed_; }
+	/// Return number of times the rate was decreased.
+	unsigned GetNumBackoffs() const { return numBackoffs_; }
+
+private:
+	/// Current rate.
+	float rate_;
+	/// Highest rate.
+	float maxRate_;
+	/// Time since the last flush in seconds.
+	float sinceFlush_;
+	/// Time since the last decrease in seconds.
+	float sinceBackoff_;
+	/// Lowest round trip time seen in milliseconds, zero before the first measurement.
+	float minRoundTripTime_;
+	/// Number of decreases.
+	unsigned numBackoffs_;
+	/// Congestion on the last update.
+	bool congested_;
+	/// Rate change on the last update.
+	bool changed_;
+};
@@ -0,0 +1,54 @@
+#include <Urho3D/Core/WorkQueue.h>
+
+#include "Common.h"
+#include "DrawCommand.h"
+#include "InterestFanout.h"
+
+/// Work function encoding a range of interest group pointers.
+static void EncodeInterestFanoutWork(const WorkItem* item, unsigned threadIndex)
+{
+	const DrawHistory& history = *static_cast<const DrawHistory*>(item->aux_);
+	InterestFanout** end = static_cast<InterestFanout**>(item->end_);
+	for (InterestFanout** fanout = static_cast<InterestFanout**>(item->start_); fanout != end; ++fanout)
+		EncodeInterestFanout(**fanout, history);
+}
+
+void EncodeInterestFanout(InterestFanout& fanout, const DrawHistory& history)
+{
+	const PODVector<unsigned>& selection = fanout.selection_;
+	fanout.numMessages_ = (selection.Size() + MAX_DRAWCOMMANDS_PER_BATCH - 1) / MAX_DRAWCOMMANDS_PER_BATCH;
+	if (fanout.messages_.Size() < fanout.numMessages_)
+		fanout.messages_.Resize(fanout.numMessages_);
+
+	for (unsigned i = 0; i < fanout.numMessages_; ++i)
+	{
+		unsigned first = i * MAX_DRAWCOMMANDS_PER_BATCH;
+		fanout.messages_[i].Clear();
+		WriteDrawConfirms(fanout.messages_[i], history, &selection[first], Min(selection.Size() - first,
+			MAX_DRAWCOMMANDS_PER_BATCH), 0);
+	}
+}
+
+void EncodeInterestFanouts(const PODVector<InterestFanout*>& fanouts, const DrawHistory& history, WorkQueue* queue)
+{
+	unsigned numItems = queue ? Min(fanouts.Size(), queue->GetNumThreads() + 1) : 0;
+	if (numItems <= 1)
+	{
+		for (unsigned i = 0; i < fanouts.Size(); ++i)
+			EncodeInterestFanout(*fanouts[i], history);
+		return;
+	}
+
+	// Each item writes only the groups of its own range
+	for (unsigned i = 0; i < numItems; ++i)
+	{
+		SharedPtr<WorkItem> item = queue->GetFreeItem();
+		item->priority_ = M_MAX_UNSIGNED;
+		item->workFunction_ = EncodeInterestFanoutWork;
+		item->aux_ = const_cast<DrawHistory*>(&history);
+		item->start_ = const_cast<InterestFanout**>(&fanouts[0]) + i * fanouts.Size() / numItems;
+		item->end_ = const_cast<InterestFanout**>(&fanouts[0]) + (i + 1) * fanouts.Size() / numItems;
+		queue->AddWorkItem(item);
+	}
+	queue->Complete(M_MAX_UNSIGNED);
+}
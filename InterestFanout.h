@@ -0,0 +1,37 @@
+#pragma once
+
+#include <Urho3D/IO/VectorBuffer.h>
+
+namespace Urho3D
+{
+
+class WorkQueue;
+
+}
+
+using namespace Urho3D;
+
+class DrawHistory;
+
+/// Confirm batches of one interest group during a filtered broadcast. Encoded once, possibly on a worker thread, and sent
+/// to every connection of the group.
+struct InterestFanout
+{
+	/// Construct.
+	InterestFanout() : numMessages_(0) {}
+
+	/// Commands selected for the group.
+	PODVector<unsigned> selection_;
+	/// Encoded batches. Buffers are kept between broadcasts to reuse their memory.
+	Vector<VectorBuffer> messages_;
+	/// Number of batches encoded for the current broadcast.
+	unsigned numMessages_;
+};
+
+/// Encode the selected history commands of one interest group into confirm batches. Only reads the history, so it may run
+/// on a worker thread.
+void EncodeInterestFanout(InterestFanout& fanout, const DrawHistory& history);
+/// Encode interest groups with commands selected. With a work queue the groups are split into contiguous ranges for its
+/// worker threads and the calling thread, unless that leaves a single range; without one they are encoded on the calling
+/// thread.
+void EncodeInterestFanouts(const PODVector<InterestFanout*>& fanouts, const DrawHistory& history, WorkQueue* queue);
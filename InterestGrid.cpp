@@ -0,0 +1,140 @@
+#include <Urho3D/Math/MathDefs.h>
+
+#include "InterestGrid.h"
+
+static bool Overlaps(const IntRect& a, const IntRect& b)
+{
+	return a.left_ < b.right_ && a.right_ > b.left_ && a.top_ < b.bottom_ && a.bottom_ > b.top_;
+}
+
+static bool IsFullTable(const IntRect& rect)
+{
+	return rect.left_ == 0 && rect.top_ == 0 && rect.right_ == DRAWING_TABLE_SIZE && rect.bottom_ == DRAWING_TABLE_SIZE;
+}
+
+IntRect SnapToInterestCells(const IntRect& region)
+{
+	int left = Max(region.left_, 0);
+	int top = Max(region.top_, 0);
+	int right = Min(region.right_, DRAWING_TABLE_SIZE);
+	int bottom = Min(region.bottom_, DRAWING_TABLE_SIZE);
+	if (right <= left || bottom <= top)
+		return IntRect::ZERO;
+
+	// The table side is a multiple of the cell size, so rounding outward stays on the table
+	return IntRect(left / INTEREST_CELL_SIZE * INTEREST_CELL_SIZE, top / INTEREST_CELL_SIZE * INTEREST_CELL_SIZE,
+		(right + INTEREST_CELL_SIZE - 1) / INTEREST_CELL_SIZE * INTEREST_CELL_SIZE,
+		(bottom + INTEREST_CELL_SIZE - 1) / INTEREST_CELL_SIZE * INTEREST_CELL_SIZE);
+}
+
+InterestGrid::InterestGrid() :
+	numPartial_(0)
+{
+	cells_.Resize(INTEREST_GRID_SIZE * INTEREST_GRID_SIZE);
+}
+
+unsigned InterestGrid::Subscribe(const IntRect& region)
+{
+	// Commands are selected per cell anyway, so regions within the same cells need not be told apart
+	IntRect clipped = SnapToInterestCells(region);
+
+	// Region changes are rare, while the groups are few compared to the commands they are queried for
+	for (unsigned i = 0; i < regions_.Size(); ++i)
+	{
+		if (refCounts_[i] && regions_[i] == clipped)
+		{
+			++refCounts_[i];
+			return i;
+		}
+	}
+
+	unsigned id;
+	if (freeIDs_.Size())
+	{
+		id = freeIDs_.Back();
+		freeIDs_.Pop();
+	}
+	else
+	{
+		id = regions_.Size();
+		regions_.Push(IntRect::ZERO);
+		refCounts_.Push(0);
+		// Masks grow a word at a time
+		if (id >= query_.GetSize())
+		{
+			for (unsigned i = 0; i < cells_.Size(); ++i)
+				cells_[i].Resize(id + 1);
+			query_.Resize(id + 1);
+		}
+	}
+
+	regions_[id] = clipped;
+	refCounts_[id] = 1;
+	if (!IsFullTable(clipped))
+		++numPartial_;
+	Link(id);
+	return id;
+}
+
+void InterestGrid::Unsubscribe(unsigned id)
+{
+	if (id >= refCounts_.Size() || !refCounts_[id] || --refCounts_[id])
+		return;
+
+	Unlink(id);
+	if (!IsFullTable(regions_[id]))
+		--numPartial_;
+	freeIDs_.Push(id);
+}
+
+void InterestGrid::Query(const IntRect& rect, PODVector<unsigned>& dest)
+{
+	dest.Clear();
+
+	int x1 = Max(rect.left_, 0) / INTEREST_CELL_SIZE;
+	int y1 = Max(rect.top_, 0) / INTEREST_CELL_SIZE;
+	int x2 = Min(rect.right_ - 1, DRAWING_TABLE_SIZE - 1) / INTEREST_CELL_SIZE;
+	int y2 = Min(rect.bottom_ - 1, DRAWING_TABLE_SIZE - 1) / INTEREST_CELL_SIZE;
+	if (x2 < x1 || y2 < y1)
+		return;
+
+	query_.ClearAll();
+	for (int y = y1; y <= y2; ++y)
+	{
+		for (int x = x1; x <= x2; ++x)
+			query_.Merge(cells_[y * INTEREST_GRID_SIZE + x]);
+	}
+
+	// A group's region need not cover its cells entirely
+	for (unsigned id = query_.FindNext(0); id != M_MAX_UNSIGNED; id = query_.FindNext(id + 1))
+	{
+		if (Overlaps(regions_[id], rect))
+			dest.Push(id);
+	}
+}
+
+void InterestGrid::Link(unsigned id)
+{
+	const IntRect& region = regions_[id];
+	if (region.right_ <= region.left_)
+		return;
+
+	for (int y = region.top_ / INTEREST_CELL_SIZE; y <= (region.bottom_ - 1) / INTEREST_CELL_SIZE; ++y)
+	{
+		for (int x = region.left_ / INTEREST_CELL_SIZE; x <= (region.right_ - 1) / INTEREST_CELL_SIZE; ++x)
+			cells_[y * INTEREST_GRID_SIZE + x].Set(id);
+	}
+}
+
+void InterestGrid::Unlink(unsigned id)
+{
+	const IntRect& region = regions_[id];
+	if (region.right_ <= region.left_)
+		return;
+
+	for (int y = region.top_ / INTEREST_CELL_SIZE; y <= (region.bottom_ - 1) / INTEREST_CELL_SIZE; ++y)
+	{
+		for (int x = region.left_ / INTEREST_CELL_SIZE; x <= (region.right_ - 1) / INTEREST_CELL_SIZE; ++x)
+			cells_[y * INTEREST_GRID_SIZE + x].Clear(id);
+	}
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <Urho3D/Container/Vector.h>
+#include <Urho3D/Math/Rect.h>
+
+#include "DirtyMask.h"
+#include "DrawCommand.h"
+
+using namespace Urho3D;
+
+/// Side of an interest grid cell in table pixels.
+static const int INTEREST_CELL_SIZE = 64;
+/// Interest grid cells per table side.
+static const int INTEREST_GRID_SIZE = DRAWING_TABLE_SIZE / INTEREST_CELL_SIZE;
+
+/// Return region in table pixels grown outward to whole interest grid cells and clipped to the table, or IntRect::ZERO if it
+/// covers no cell.
+IntRect SnapToInterestCells(const IntRect& region);
+
+/// Spatial grid of interest groups: subscribers to the same table region. Each cell has a bit mask of the groups whose region
+/// overlaps it, so the receivers of a draw command are the OR of the few cells its circle touches instead of a test of every
+/// subscriber.
+class InterestGrid
+{
+public:
+	/// Construct empty.
+	InterestGrid();
+
+	/// Subscribe to region of interest in table pixels, snapped to whole cells. Subscribers covering the same cells share an
+	/// interest group, so commands are selected and encoded once for all of them. Return the group ID.
+	unsigned Subscribe(const IntRect& region);
+	/// Release a subscription to a group. The group ID is reused once its last subscriber is gone.
+	void Unsubscribe(unsigned id);
+	/// Collect groups whose region overlaps the pixel rectangle, each once.
+	void Query(const IntRect& rect, PODVector<unsigned>& dest);
+
+	/// Return region of interest of a group.
+	const IntRect& GetRegion(unsigned id) const { return regions_[id]; }
+	/// Return number of subscribers of a group, zero if unused.
+	unsigned GetNumSubscribers(unsigned id) const { return refCounts_[id]; }
+	/// Return whether every group covers the whole table, so nothing needs to be filtered.
+	bool IsUnfiltered() const { return !numPartial_; }
+	/// Return one past the highest group ID in use.
+	unsigned GetMaxGroups() const { return regions_.Size(); }
+
+private:
+	/// Add group to the cells its region overlaps.
+	void Link(unsigned id);
+	/// Remove group from the cells its region overlaps.
+	void Unlink(unsigned id);
+
+	/// Group mask per cell, row by row.
+	Vector<DirtyMask> cells_;
+	/// Region per group ID.
+	PODVector<IntRect> regions_;
+	/// Subscribers per group ID, zero if unused.
+	PODVector<unsigned> refCounts_;
+	/// Unused group IDs.
+	PODVector<unsigned> freeIDs_;
+	/// Groups collected by the current query.
+	DirtyMask query_;
+	/// Number of groups interested in less than the whole table.
+	unsigned numPartial_;
+};
@@ -0,0 +1,83 @@
+#include <Urho3D/Math/MathDefs.h>
+
+#include "LatencyHistogram.h"
+
+/// log2(SUB_BUCKETS).
+static const unsigned SUB_BUCKET_BITS = 5;
+/// Buckets needed for the full unsigned range.
+static const unsigned NUM_BUCKETS = LatencyHistogram::LINEAR_BUCKETS + (32 - SUB_BUCKET_BITS - 1) * LatencyHistogram::SUB_BUCKETS;
+
+LatencyHistogram::LatencyHistogram() :
+	buckets_(NUM_BUCKETS),
+	count_(0),
+	max_(0),
+	sum_(0)
+{
+	Reset();
+}
+
+void LatencyHistogram::Record(unsigned value)
+{
+	++buckets_[GetBucket(value)];
+	++count_;
+	max_ = Max(max_, value);
+	sum_ += value;
+}
+
+void LatencyHistogram::Merge(const LatencyHistogram& other)
+{
+	for (unsigned i = 0; i < NUM_BUCKETS; ++i)
+		buckets_[i] += other.buckets_[i];
+	count_ += other.count_;
+	max_ = Max(max_, other.max_);
+	sum_ += other.sum_;
+}
+
+void LatencyHistogram::Reset()
+{
+	for (unsigned i = 0; i < NUM_BUCKETS; ++i)
+		buckets_[i] = 0;
+	count_ = 0;
+	max_ = 0;
+	sum_ = 0;
+}
+
+unsigned LatencyHistogram::GetPercentile(float fraction) const
+{
+	if (!count_)
+		return 0;
+
+	unsigned long long target = (unsigned long long)(Clamp(fraction, 0.0f, 1.0f) * count_ + 0.5f);
+	target = Clamp(target, 1ULL, (unsigned long long)count_);
+
+	unsigned long long seen = 0;
+	for (unsigned i = 0; i < NUM_BUCKETS; ++i)
+	{
+		seen += buckets_[i];
+		if (seen >= target)
+			return Min(GetBucketMax(i), max_);
+	}
+	return max_;
+}
+
+unsigned LatencyHistogram::GetBucket(unsigned value)
+{
+	if (value < LINEAR_BUCKETS)
+		return value;
+
+	// Keep the top SUB_BUCKET_BITS + 1 bits of the value
+	unsigned shift = 0;
+	while ((value >> shift) >= LINEAR_BUCKETS)
+		++shift;
+	return LINEAR_BUCKETS + (shift - 1) * SUB_BUCKETS + ((value >> shift) - SUB_BUCKETS);
+}
+
+unsigned LatencyHistogram::GetBucketMax(unsigned bucket)
+{
+	if (bucket < LINEAR_BUCKETS)
+		return bucket;
+
+	unsigned shift = (bucket - LINEAR_BUCKETS) / SUB_BUCKETS + 1;
+	unsigned long long top = (unsigned long long)((bucket - LINEAR_BUCKETS) % SUB_BUCKETS + SUB_BUCKETS + 1) << shift;
+	return (unsigned)Min(top - 1, (unsigned long long)M_MAX_UNSIGNED);
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <Urho3D/Container/Vector.h>
+
+using namespace Urho3D;
+
+/// Latency histogram with logarithmic buckets of constant relative precision (HDR style.) Values are in microseconds.
+/// Values below LINEAR_BUCKETS are counted exactly, above that every power of two is split into SUB_BUCKETS buckets.
+class LatencyHistogram
+{
+public:
+	/// Exactly counted values.
+	static const unsigned LINEAR_BUCKETS = 64;
+	/// Buckets per power of two above the linear range, giving about 3% precision.
+	static const unsigned SUB_BUCKETS = LINEAR_BUCKETS / 2;
+
+	/// Construct empty.
+	LatencyHistogram();
+
+	/// Record a value.
+	void Record(unsigned value);
+	/// Add all values recorded by another histogram.
+	void Merge(const LatencyHistogram& other);
+	/// Remove all values.
+	void Reset();
+
+	/// Return value at or below which the given fraction of values lie, rounded up to the bucket's upper bound.
+	unsigned GetPercentile(float fraction) const;
+	/// Return number of recorded values.
+	unsigned GetCount() const { return count_; }
+	/// Return largest recorded value.
+	unsigned GetMax() const { return max_; }
+	/// Return mean of recorded values.
+	float GetMean() const { return count_ ? (float)(sum_ / count_) : 0.0f; }
+
+private:
+	/// Return bucket of a value.
+	static unsigned GetBucket(unsigned value);
+	/// Return largest value falling into a bucket.
+	static unsigned GetBucketMax(unsigned bucket);
+
+	/// Count per bucket.
+	PODVector<unsigned> buckets_;
+	/// Number of values.
+	unsigned count_;
+	/// Largest value.
+	unsigned max_;
+	/// Sum of values.
+	unsigned long long sum_;
+};
@@ -0,0 +1,273 @@
+#include <Urho3D/Core/CoreEvents.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/IO/MemoryBuffer.h>
+#include <Urho3D/IO/VectorBuffer.h>
+#include <Urho3D/Network/Connection.h>
+#include <Urho3D/Network/Network.h>
+#include <Urho3D/Network/NetworkEvents.h>
+#include <Urho3D/Scene/Scene.h>
+#include <Urho3D/Urho2D/Drawable2D.h>
+
+#include "CirclePainter.h"
+#include "Common.h"
+#include "DrawCommand.h"
+#include "DrawStats.h"
+#include "LoadGenerator.h"
+#include "MessagePool.h"
+
+/// Standard deviation of clustered requests around the bot's hotspot in table pixels.
+static const float CLUSTER_DEVIATION = 16.0f;
+
+BotClient::BotClient() :
+	objectID_(0),
+	hotspot_(Vector2::ZERO),
+	drawAcc_(0.0f),
+	drawsSent_(0),
+	tableSequence_(0),
+	tableBands_(0),
+	requestAck_(0)
+{
+}
+
+LoadGenerator::LoadGenerator(Context* context) :
+	Object(context),
+	rate_(10.0f),
+	distribution_(BD_UNIFORM)
+{
+}
+
+LoadGenerator::~LoadGenerator()
+{
+	Stop();
+}
+
+void LoadGenerator::SetRate(float drawsPerSecond)
+{
+	rate_ = Max(drawsPerSecond, 0.0f);
+}
+
+void LoadGenerator::SetDistribution(BotDistribution distribution)
+{
+	distribution_ = distribution;
+}
+
+void LoadGenerator::Start(const String& address, unsigned short port, unsigned numBots)
+{
+	Stop();
+
+	// Remote events are checked against the Network subsystem even for connections of other Network instances
+	GetSubsystem<Network>()->RegisterRemoteEvent(E_CLIENTOBJECTID);
+
+	float halfExtent = DRAWING_TABLE_SIZE * PIXEL_SIZE / 2.0f;
+
+	bots_.Resize(numBots);
+	for (unsigned i = 0; i < numBots; ++i)
+	{
+		BotClient& bot = bots_[i];
+		bot.network_ = new Network(context_);
+		bot.scene_ = new Scene(context_);
+		bot.hotspot_ = Vector2(Random(-halfExtent, halfExtent), Random(-halfExtent, halfExtent));
+
+		if (!bot.network_->Connect(address, port, bot.scene_))
+		{
+			URHO3D_LOGERROR(ToString("Bot %u failed to connect to %s:%d", i, address.CString(), port));
+			continue;
+		}
+
+		Connection* connection = bot.network_->GetServerConnection();
+		SubscribeToEvent(connection, E_CLIENTOBJECTID, URHO3D_HANDLER(LoadGenerator, HandleClientObjectID));
+		SubscribeToEvent(connection, E_NETWORKMESSAGE, URHO3D_HANDLER(LoadGenerator, HandleNetworkMessage));
+	}
+
+	SubscribeToEvent(E_UPDATE, URHO3D_HANDLER(LoadGenerator, HandleUpdate));
+	SubscribeToEvent(E_DRAWSTATSEXPORT, URHO3D_HANDLER(LoadGenerator, HandleDrawStatsExport));
+	reportTimer_.Reset();
+	URHO3D_LOGINFO(ToString("Started %u bots at %.1f draws/s each", numBots, rate_));
+}
+
+void LoadGenerator::Stop()
+{
+	for (unsigned i = 0; i < bots_.Size(); ++i)
+	{
+		if (bots_[i].painter_)
+			bots_[i].painter_->ResetAuthority();
+		bots_[i].network_->Disconnect();
+	}
+
+	bots_.Clear();
+	UnsubscribeFromAllEvents();
+}
+
+void LoadGenerator::HandleUpdate(StringHash eventType, VariantMap& eventData)
+{
+	using namespace Update;
+
+	float timeStep = eventData[P_TIMESTEP].GetFloat();
+	float interval = rate_ > 0.0f ? 1.0f / rate_ : M_INFINITY;
+
+	for (unsigned i = 0; i < bots_.Size(); ++i)
+	{
+		BotClient& bot = bots_[i];
+		CheckAuthority(bot);
+		if (!bot.painter_)
+			continue;
+
+		bot.drawAcc_ += timeStep;
+		while (bot.drawAcc_ >= interval)
+		{
+			bot.drawAcc_ -= interval;
+			bot.painter_->QueueDraw(GetDrawPosition(bot));
+			++bot.drawsSent_;
+		}
+	}
+}
+
+void LoadGenerator::HandleClientObjectID(StringHash eventType, VariantMap& eventData)
+{
+	BotClient* bot = GetBot(static_cast<Connection*>(GetEventSender()));
+	if (bot)
+		bot->objectID_ = eventData[P_ID].GetUInt();
+}
+
+void LoadGenerator::HandleNetworkMessage(StringHash eventType, VariantMap& eventData)
+{
+	using namespace NetworkMessage;
+
+	int msgID = eventData[P_MESSAGEID].GetInt();
+	if (msgID != MSG_DRAWCONFIRMBATCH && msgID != MSG_DRAWCONFIRMDELTA && msgID != MSG_TABLESNAPSHOT &&
+		msgID != MSG_DRAWREQUESTACK)
+		return;
+
+	Connection* connection = static_cast<Connection*>(eventData[P_CONNECTION].GetPtr());
+	BotClient* bot = GetBot(connection);
+	if (!bot)
+		return;
+
+	MemoryBuffer msg(eventData[P_DATA].GetBuffer());
+	if (msgID == MSG_TABLESNAPSHOT)
+	{
+		// Only the sequence number matters, bots keep no table
+		bot->tableSequence_ = msg.ReadUInt();
+		++bot->tableBands_;
+		return;
+	}
+	if (msgID == MSG_DRAWCONFIRMDELTA)
+	{
+		HandleDrawConfirmDelta(*bot, connection, msg);
+		return;
+	}
+
+	DrawStats* stats = GetSubsystem<DrawStats>();
+	if (msgID == MSG_DRAWREQUESTACK)
+	{
+		stats->RequestsAcknowledged(connection, msg.ReadUInt());
+		return;
+	}
+
+	DrawConfirmReader reader(msg);
+	DrawCommand command;
+	unsigned sequence;
+	while (reader.Read(command, sequence))
+		stats->ConfirmReceived(connection, command.position, command.color);
+}
+
+void LoadGenerator::HandleDrawConfirmDelta(BotClient& bot, Connection* connection, MemoryBuffer& msg)
+{
+	DrawDeltaHeader header;
+	header.Read(msg);
+	if (header.base_ > bot.tableSequence_ || header.numBands_ > bot.tableBands_)
+		return;
+
+	DrawStats* stats = GetSubsystem<DrawStats>();
+	DrawConfirmReader reader(msg);
+	DrawCommand command;
+	unsigned sequence;
+	while (reader.Read(command, sequence))
+	{
+		if (sequence >= bot.tableSequence_)
+			stats->ConfirmReceived(connection, command.position, command.color);
+	}
+	bot.tableSequence_ = Max(bot.tableSequence_, header.end_);
+	bot.requestAck_ = Max(bot.requestAck_, header.lastRequest_);
+	stats->RequestsAcknowledged(connection, bot.requestAck_);
+
+	PooledMessage ack(GetSubsystem<MessagePool>());
+	ack->WriteUInt(bot.tableSequence_);
+	ack->WriteUInt(bot.requestAck_);
+	connection->SendMessage(MSG_DRAWDELTAACK, false, false, *ack);
+}
+
+void LoadGenerator::CheckAuthority(BotClient& bot)
+{
+	if (bot.painter_ || !bot.objectID_)
+		return;
+
+	Node* node = bot.scene_->GetNode(bot.objectID_);
+	CirclePainter* painter = node ? node->GetComponent<CirclePainter>() : 0;
+	if (!painter)
+		return;
+
+	painter->TakeAuthority(bot.network_);
+	bot.painter_ = painter;
+}
+
+BotClient* LoadGenerator::GetBot(Connection* connection)
+{
+	for (unsigned i = 0; i < bots_.Size(); ++i)
+	{
+		if (bots_[i].network_->GetServerConnection() == connection)
+			return &bots_[i];
+	}
+	return 0;
+}
+
+Vector2 LoadGenerator::GetDrawPosition(const BotClient& bot) const
+{
+	float halfExtent = DRAWING_TABLE_SIZE * PIXEL_SIZE / 2.0f;
+
+	Vector2 position;
+	if (distribution_ == BD_CLUSTERED)
+	{
+		float variance = (CLUSTER_DEVIATION * PIXEL_SIZE) * (CLUSTER_DEVIATION * PIXEL_SIZE);
+		position = Vector2(RandomNormal(bot.hotspot_.x_, variance), RandomNormal(bot.hotspot_.y_, variance));
+	}
+	else
+		position = Vector2(Random(-halfExtent, halfExtent), Random(-halfExtent, halfExtent));
+
+	position.x_ = Clamp(position.x_, -halfExtent, halfExtent);
+	position.y_ = Clamp(position.y_, -halfExtent, halfExtent);
+	return position;
+}
+
+void LoadGenerator::HandleDrawStatsExport(StringHash eventType, VariantMap& eventData)
+{
+	DrawStats* stats = GetSubsystem<DrawStats>();
+	float elapsed = Max(reportTimer_.GetMSec(true) / 1000.0f, 0.001f);
+	unsigned totalSent = 0;
+	LatencyHistogram total;
+
+	for (unsigned i = 0; i < bots_.Size(); ++i)
+	{
+		BotClient& bot = bots_[i];
+		Connection* connection = bot.network_->GetServerConnection();
+		const ConnectionDrawStats* botStats = connection ? stats->GetStats(connection) : 0;
+		if (!botStats)
+			continue;
+
+		const LatencyHistogram& latency = botStats->confirmLatency_;
+		URHO3D_LOGINFO(ToString("Bot %u: rtt %.1f ms, sent %.1f/s, confirmed %.1f/s, in %.1f KB/s, out %.1f KB/s, "
+			"confirm latency p50 %.1f p99 %.1f p999 %.1f ms, %u unconfirmed", i, connection->GetRoundTripTime(),
+			bot.drawsSent_ / elapsed, latency.GetCount() / elapsed, connection->GetBytesInPerSec() / 1024.0f,
+			connection->GetBytesOutPerSec() / 1024.0f, latency.GetPercentile(0.5f) / 1000.0f,
+			latency.GetPercentile(0.99f) / 1000.0f, latency.GetPercentile(0.999f) / 1000.0f,
+			botStats->pending_.Size()));
+
+		totalSent += bot.drawsSent_;
+		total.Merge(latency);
+		bot.drawsSent_ = 0;
+	}
+
+	URHO3D_LOGINFO(ToString("All bots: sent %.1f/s, confirmed %.1f/s, confirm latency p50 %.1f p99 %.1f p999 %.1f ms",
+		totalSent / elapsed, total.GetCount() / elapsed, total.GetPercentile(0.5f) / 1000.0f,
+		total.GetPercentile(0.99f) / 1000.0f, total.GetPercentile(0.999f) / 1000.0f));
+}
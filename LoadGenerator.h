@@ -0,0 +1,106 @@
+#pragma once
+
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Core/Timer.h>
+
+namespace Urho3D
+{
+
+class Connection;
+class MemoryBuffer;
+class Network;
+class Scene;
+
+}
+
+using namespace Urho3D;
+
+class CirclePainter;
+
+/// Spatial distribution of bot draw requests.
+enum BotDistribution
+{
+	/// Uniformly over the whole table.
+	BD_UNIFORM = 0,
+	/// Normally distributed around a random spot per bot.
+	BD_CLUSTERED
+};
+
+/// Simulated painter with its own network connection and scene.
+struct BotClient
+{
+	/// Construct.
+	BotClient();
+
+	/// Network instance owning the connection.
+	SharedPtr<Network> network_;
+	/// Replicated scene.
+	SharedPtr<Scene> scene_;
+	/// Own painter once replicated.
+	WeakPtr<CirclePainter> painter_;
+	/// Node ID of the own painter sent by the server.
+	unsigned objectID_;
+	/// Center of clustered requests.
+	Vector2 hotspot_;
+	/// Accumulated time for the request rate.
+	float drawAcc_;
+	/// Requests sent since the last report.
+	unsigned drawsSent_;
+	/// Sequence number of the next confirmed command expected in a delta.
+	unsigned tableSequence_;
+	/// Number of table snapshot bands received.
+	unsigned tableBands_;
+	/// Last own draw request acknowledged by a delta.
+	unsigned requestAck_;
+};
+
+/// Headless load generator simulating many painters from one process. Each bot opens its own Network instance and connection.
+/// Confirm latencies are measured by the DrawStats subsystem and reported per bot whenever it exports.
+class LoadGenerator : public Object
+{
+	URHO3D_OBJECT(LoadGenerator, Object);
+
+public:
+	/// Construct.
+	LoadGenerator(Context* context);
+	/// Destruct. Disconnects all bots.
+	~LoadGenerator();
+
+	/// Set draw requests per second per bot.
+	void SetRate(float drawsPerSecond);
+	/// Set spatial distribution of requests.
+	void SetDistribution(BotDistribution distribution);
+	/// Connect bots to the server.
+	void Start(const String& address, unsigned short port, unsigned numBots);
+	/// Disconnect all bots.
+	void Stop();
+
+	/// Return number of bots.
+	unsigned GetNumBots() const { return bots_.Size(); }
+
+private:
+	/// Handle frame update: emit requests and report statistics.
+	void HandleUpdate(StringHash eventType, VariantMap& eventData);
+	/// Handle E_CLIENTOBJECTID remote event of a bot connection.
+	void HandleClientObjectID(StringHash eventType, VariantMap& eventData);
+	/// Handle custom network messages of a bot connection.
+	void HandleNetworkMessage(StringHash eventType, VariantMap& eventData);
+	/// Handle delta from the server like a client does, without drawing.
+	void HandleDrawConfirmDelta(BotClient& bot, Connection* connection, MemoryBuffer& msg);
+	/// Handle draw statistics export: log the statistics of all bots.
+	void HandleDrawStatsExport(StringHash eventType, VariantMap& eventData);
+	/// Take authority over the bot's painter once it has been replicated.
+	void CheckAuthority(BotClient& bot);
+	/// Return bot owning the connection, or null.
+	BotClient* GetBot(Connection* connection);
+	/// Return next request position of a bot.
+	Vector2 GetDrawPosition(const BotClient& bot) const;
+	/// Simulated painters.
+	Vector<BotClient> bots_;
+	/// Time since the last report.
+	Timer reportTimer_;
+	/// Requests per second per bot.
+	float rate_;
+	/// Request distribution.
+	BotDistribution distribution_;
+};
@@ -0,0 +1,119 @@
+#include <Urho3D/Core/CoreEvents.h>
+#include <Urho3D/Core/StringUtils.h>
+#include <Urho3D/Engine/DebugHud.h>
+
+#include "MessagePool.h"
+
+/// Return the smallest size class holding size bytes, or MESSAGEPOOL_NUM_CLASSES if none does.
+static unsigned GetSizeClass(unsigned size)
+{
+	unsigned sizeClass = 0;
+	while (sizeClass < MESSAGEPOOL_NUM_CLASSES && (1U << (sizeClass + MESSAGEPOOL_MIN_CLASS)) < size)
+		++sizeClass;
+	return sizeClass;
+}
+
+MessagePool::MessagePool(Context* context) :
+	Object(context),
+	numAllocations_(0),
+	frameAllocations_(0),
+	lastFrameAllocations_(0),
+	numInUse_(0)
+{
+	SubscribeToEvent(E_ENDFRAME, URHO3D_HANDLER(MessagePool, HandleEndFrame));
+}
+
+MessagePool::~MessagePool()
+{
+	for (unsigned i = 0; i < MESSAGEPOOL_NUM_CLASSES; ++i)
+	{
+		for (unsigned j = 0; j < free_[i].Size(); ++j)
+			delete free_[i][j];
+	}
+}
+
+unsigned MessagePool::GetNumFree() const
+{
+	unsigned numFree = 0;
+	for (unsigned i = 0; i < MESSAGEPOOL_NUM_CLASSES; ++i)
+		numFree += free_[i].Size();
+	return numFree;
+}
+
+VectorBuffer* MessagePool::Acquire(unsigned size)
+{
+	++numInUse_;
+
+	// Any buffer of the same or a larger class will do
+	unsigned sizeClass = GetSizeClass(size);
+	for (unsigned i = sizeClass; i < MESSAGEPOOL_NUM_CLASSES; ++i)
+	{
+		if (free_[i].Size())
+		{
+			VectorBuffer* buffer = free_[i].Back();
+			free_[i].Pop();
+			return buffer;
+		}
+	}
+
+	// The buffer object and its data. Resizing from empty reserves exactly the class capacity
+	VectorBuffer* buffer = new VectorBuffer();
+	if (sizeClass < MESSAGEPOOL_NUM_CLASSES)
+		size = 1U << (sizeClass + MESSAGEPOOL_MIN_CLASS);
+	buffer->Resize(size);
+	buffer->Clear();
+	numAllocations_ += 2;
+	frameAllocations_ += 2;
+	return buffer;
+}
+
+void MessagePool::Release(VectorBuffer* buffer, unsigned capacity)
+{
+	--numInUse_;
+
+	unsigned newCapacity = buffer->GetBuffer().Capacity();
+	if (newCapacity != capacity)
+	{
+		++numAllocations_;
+		++frameAllocations_;
+	}
+
+	// Filed under the largest class it covers, so it satisfies any request of that class
+	unsigned sizeClass = GetSizeClass(newCapacity + 1);
+	if (!sizeClass || newCapacity > 1U << (MESSAGEPOOL_NUM_CLASSES - 1 + MESSAGEPOOL_MIN_CLASS))
+	{
+		delete buffer;
+		return;
+	}
+
+	buffer->Clear();
+	free_[sizeClass - 1].Push(buffer);
+}
+
+void MessagePool::HandleEndFrame(StringHash eventType, VariantMap& eventData)
+{
+	lastFrameAllocations_ = frameAllocations_;
+	frameAllocations_ = 0;
+
+	DebugHud* debugHud = GetSubsystem<DebugHud>();
+	if (debugHud)
+	{
+		debugHud->SetAppStats("Message buffers", ToString("%u in use, %u free, %u allocations last frame, %u total", numInUse_,
+			GetNumFree(), lastFrameAllocations_, numAllocations_));
+	}
+}
+
+PooledMessage::PooledMessage(MessagePool* pool, unsigned size) :
+	pool_(pool)
+{
+	buffer_ = pool ? pool->Acquire(size) : new VectorBuffer();
+	capacity_ = buffer_->GetBuffer().Capacity();
+}
+
+PooledMessage::~PooledMessage()
+{
+	if (pool_)
+		pool_->Release(buffer_, capacity_);
+	else
+		delete buffer_;
+}
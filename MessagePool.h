@@ -0,0 +1,84 @@
+#pragma once
+
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/IO/VectorBuffer.h>
+
+using namespace Urho3D;
+
+/// Capacity of the smallest pooled buffers as a power of two exponent.
+static const unsigned MESSAGEPOOL_MIN_CLASS = 6;
+/// Number of buffer size classes, each twice the capacity of the previous. Larger buffers are freed on release.
+static const unsigned MESSAGEPOOL_NUM_CLASSES = 11;
+
+class PooledMessage;
+
+/// Pool of outgoing message buffers in power of two size classes. Buffers keep their memory between messages, so once the
+/// pool is warm building a message allocates nothing. Connection::SendMessage still copies the bytes into a kNet message.
+class MessagePool : public Object
+{
+	URHO3D_OBJECT(MessagePool, Object);
+
+	friend class PooledMessage;
+
+public:
+	/// Construct.
+	MessagePool(Context* context);
+	/// Destruct. Frees the pooled buffers.
+	~MessagePool();
+
+	/// Return number of heap allocations made for buffers so far, counting each growth while in use once.
+	unsigned GetNumAllocations() const { return numAllocations_; }
+	/// Return number of heap allocations made during the last complete frame. Zero in the steady state.
+	unsigned GetFrameAllocations() const { return lastFrameAllocations_; }
+	/// Return number of buffers currently in use.
+	unsigned GetNumInUse() const { return numInUse_; }
+	/// Return number of pooled free buffers.
+	unsigned GetNumFree() const;
+
+private:
+	/// Return a cleared buffer with capacity for at least size bytes.
+	VectorBuffer* Acquire(unsigned size);
+	/// Return buffer to the pool. Capacity is what it had when acquired, to detect growth.
+	void Release(VectorBuffer* buffer, unsigned capacity);
+	/// Handle end of frame: roll the frame allocation counter and show the counters in the debug HUD.
+	void HandleEndFrame(StringHash eventType, VariantMap& eventData);
+
+	/// Free buffers per size class. A buffer is filed under the largest class its capacity covers.
+	PODVector<VectorBuffer*> free_[MESSAGEPOOL_NUM_CLASSES];
+	/// Total allocations.
+	unsigned numAllocations_;
+	/// Allocations during the current frame.
+	unsigned frameAllocations_;
+	/// Allocations during the last complete frame.
+	unsigned lastFrameAllocations_;
+	/// Buffers acquired and not yet released.
+	unsigned numInUse_;
+};
+
+/// Message buffer borrowed from the pool for the enclosing scope. Without a pool it owns a buffer of its own.
+class PooledMessage
+{
+public:
+	/// Acquire a cleared buffer with capacity for at least size bytes.
+	PooledMessage(MessagePool* pool, unsigned size = 0);
+	/// Release the buffer.
+	~PooledMessage();
+
+	/// Return the buffer.
+	VectorBuffer& operator *() const { return *buffer_; }
+	/// Return the buffer.
+	VectorBuffer* operator ->() const { return buffer_; }
+
+private:
+	/// Prevent copy construction.
+	PooledMessage(const PooledMessage& rhs);
+	/// Prevent assignment.
+	PooledMessage& operator =(const PooledMessage& rhs);
+
+	/// Pool the buffer came from.
+	WeakPtr<MessagePool> pool_;
+	/// Borrowed buffer.
+	VectorBuffer* buffer_;
+	/// Capacity when acquired.
+	unsigned capacity_;
+};
@@ -0,0 +1,86 @@
+#include <Urho3D/Core/Context.h>
+
+#include "PredictionLayer.h"
+
+PredictionLayer::PredictionLayer(Context* context) :
+	Object(context),
+	display_(new DrawingTable(context))
+{
+}
+
+void PredictionLayer::SetTable(DrawingTable* table)
+{
+	table_ = table;
+	predictions_.Clear();
+	if (table)
+	{
+		display_->SetCircleDiameter(table->GetCircleDiameter());
+		display_->SetAntiAlias(table->GetAntiAlias());
+		display_->CopyFrom(*table);
+	}
+}
+
+void PredictionLayer::Add(unsigned sequence, const Vector2& position, const Color& color)
+{
+	if (!table_)
+		return;
+
+	if (predictions_.Size() >= MAX_PREDICTED_DRAWS)
+		Resolve(0);
+
+	PredictedDraw draw;
+	draw.sequence_ = sequence;
+	draw.position_ = position;
+	draw.color_ = color;
+	draw.rect_ = display_->DrawCircle(position, color);
+	if (draw.rect_.right_ > draw.rect_.left_)
+		predictions_.Push(draw);
+}
+
+void PredictionLayer::Acknowledge(unsigned sequence)
+{
+	// Sequence numbers are in request order, so acknowledged predictions are always at the front
+	unsigned count = 0;
+	while (count < predictions_.Size() && predictions_[count].sequence_ <= sequence)
+		++count;
+
+	for (unsigned i = count; i > 0; --i)
+		Resolve(i - 1);
+}
+
+void PredictionLayer::Clear()
+{
+	if (table_)
+		table_->MarkDirty(IntRect(0, 0, DRAWING_TABLE_SIZE, DRAWING_TABLE_SIZE));
+	predictions_.Clear();
+}
+
+IntRect PredictionLayer::Compose()
+{
+	if (!table_)
+		return IntRect::ZERO;
+
+	IntRect rect = table_->TakeDirtyRect();
+	if (rect.right_ > rect.left_)
+	{
+		display_->CopyRect(*table_, rect);
+
+		// Predictions stay on top of everything confirmed so far. Clipping keeps blended edges outside the rectangle intact
+		for (unsigned i = 0; i < predictions_.Size(); ++i)
+		{
+			const PredictedDraw& draw = predictions_[i];
+			if (draw.rect_.left_ < rect.right_ && draw.rect_.right_ > rect.left_ && draw.rect_.top_ < rect.bottom_ &&
+				draw.rect_.bottom_ > rect.top_)
+				display_->DrawCircle(draw.position_, draw.color_, rect);
+		}
+	}
+
+	return display_->TakeDirtyRect();
+}
+
+void PredictionLayer::Resolve(unsigned index)
+{
+	if (table_)
+		table_->MarkDirty(predictions_[index].rect_);
+	predictions_.Erase(index);
+}
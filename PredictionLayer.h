@@ -0,0 +1,63 @@
+#pragma once
+
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Math/Rect.h>
+
+#include "DrawingTable.h"
+
+using namespace Urho3D;
+
+/// Maximum number of unacknowledged predictions. The oldest is rolled back when exceeded.
+static const unsigned MAX_PREDICTED_DRAWS = 256;
+
+/// Own circle drawn before the server confirmed it.
+struct PredictedDraw
+{
+	/// Client sequence number of the draw request.
+	unsigned sequence_;
+	/// Quantized world position.
+	Vector2 position_;
+	/// Predicted color.
+	Color color_;
+	/// Pixels covered in the composited image.
+	IntRect rect_;
+};
+
+/// Client side overlay of predicted circles composited over the confirmed table. Resolving a prediction restores
+/// only the pixels it covered from the confirmed table instead of redrawing everything.
+class PredictionLayer : public Object
+{
+	URHO3D_OBJECT(PredictionLayer, Object);
+
+public:
+	/// Construct.
+	PredictionLayer(Context* context);
+
+	/// Set table holding confirmed pixels. Its dirty rectangle is consumed by Compose().
+	void SetTable(DrawingTable* table);
+	/// Draw predicted circle for the request with the given client sequence number.
+	void Add(unsigned sequence, const Vector2& position, const Color& color);
+	/// Resolve predictions up to and including sequence. The server has drawn them into the confirmed table with its own
+	/// color, or rejected them, so their pixels are restored from there.
+	void Acknowledge(unsigned sequence);
+	/// Roll back all predictions.
+	void Clear();
+	/// Bring the composited image up to date with confirmed table changes and resolved predictions. Return rectangle to upload.
+	IntRect Compose();
+
+	/// Return confirmed table with predictions on top.
+	DrawingTable* GetDisplay() const { return display_; }
+	/// Return number of unacknowledged predictions.
+	unsigned GetNumPredicted() const { return predictions_.Size(); }
+
+private:
+	/// Restore pixels of prediction at index from the confirmed table on the next Compose() and remove it.
+	void Resolve(unsigned index);
+
+	/// Confirmed table.
+	WeakPtr<DrawingTable> table_;
+	/// Composited image.
+	SharedPtr<DrawingTable> display_;
+	/// Unacknowledged predictions in request order.
+	PODVector<PredictedDraw> predictions_;
+};
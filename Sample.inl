@@ -71,6 +71,10 @@ void Sample::Setup()
 
 void Sample::Start()
 {
+    // Nothing to show or control without window and graphics
+    if (engine_->IsHeadless())
+        return;
+
     if (GetPlatform() == "Android" || GetPlatform() == "iOS")
         // On mobile platform, enable touch by adding a screen joystick
         InitTouchInput();
@@ -21,6 +21,7 @@
 //
 
 #include <Urho3D/Core/CoreEvents.h>
+#include <Urho3D/Core/WorkQueue.h>
 #include <Urho3D/Engine/Engine.h>
 #include <Urho3D/Graphics/Camera.h>
 #include <Urho3D/Graphics/Graphics.h>
@@ -34,6 +35,8 @@
 #include <Urho3D/Input/Controls.h>
 #include <Urho3D/Input/Input.h>
 #include <Urho3D/IO/Log.h>
+#include <Urho3D/IO/MemoryBuffer.h>
+#include <Urho3D/IO/VectorBuffer.h>
 #include <Urho3D/Network/Connection.h>
 #include <Urho3D/Network/Network.h>
 #include <Urho3D/Network/NetworkEvents.h>
@@ -50,25 +53,31 @@
 #include <Urho3D/Graphics/Technique.h>
 #include <Urho3D/Graphics/Texture2D.h>
 
+#include <kNet/UDPMessageConnection.h>
+
 #include "SceneReplication.h"
 
 #include "CirclePainter.h"
+#include "DrawStats.h"
+#include "MessagePool.h"
 
 #include <Urho3D/DebugNew.h>
 
-static const int DRAWING_TABLE_SIZE = 512;
-
 // UDP port we will use
 static const unsigned short SERVER_PORT = 2345;
 // Identifier for our custom remote event we use to tell the client which object they control
-static const StringHash E_CLIENTOBJECTID("ClientObjectID");
+const StringHash E_CLIENTOBJECTID("ClientObjectID");
 // Identifier for the node ID parameter in the event data
-static const StringHash P_ID("ID");
+const StringHash P_ID("ID");
 
-static const StringHash E_DRAWCOMMAND_REQUEST("DrawCommandRequest");
-static const StringHash E_DRAWCOMMAND_CONFIRM("DrawCommandConfirm");
-static const StringHash P_DC_POSITION("DrawCommandPosition");
-static const StringHash P_DC_COLOR("DrawCommandColor");
+// Confirms for fewer clients than this are encoded on the main thread even with -parallelfanout
+static const unsigned MIN_PARALLEL_FANOUT = 16;
+// Commands a delta may span from the baseline. A client further behind is resynchronized from snapshot bands instead
+static const unsigned MAX_DELTA_SPAN = 8 * MAX_DRAWCOMMANDS_PER_DELTA;
+// Default tick rate of the dedicated server
+static const float DEFAULT_TICK_RATE = 30.0f;
+// Ticks run at most per frame. After a longer hitch the dedicated server drops the time instead of catching up
+static const unsigned MAX_TICKS_PER_FRAME = 4;
 
 // Control bits we define
 static const unsigned CTRL_FORWARD = 1;
@@ -79,21 +88,117 @@ static const unsigned CTRL_RIGHT = 8;
 URHO3D_DEFINE_APPLICATION_MAIN(SceneReplication)
 
 SceneReplication::SceneReplication(Context* context) :
-	Sample(context), clientObjectAuth_(false)
+	Sample(context), broadcastStart_(0), parallelFanout_(false), baselineDeltas_(false), antiAlias_(false), sendBudget_(0.0f), adaptiveRate_(false),
+	decodeThread_(false), requestRate_(0.0f), requestBurst_(0.0f), interestRegion_(IntRect::ZERO), snapshotSequence_(0),
+	snapshotTick_(0), tick_(0), tickRate_(DEFAULT_TICK_RATE), tickAcc_(0.0f), tableSequence_(0), tableTick_(0), tableBands_(0),
+	requestAck_(0), clientObjectAuth_(false), headless_(false), serverPort_(SERVER_PORT), serverAddress_("localhost"),
+	numBots_(0), botRate_(10.0f), botDistribution_(BD_UNIFORM), statsInterval_(10.0f), historyHorizon_(DEFAULT_HISTORY_HORIZON)
 {
 	CirclePainter::RegisterObject(context);
 }
 
+void SceneReplication::Setup()
+{
+	Sample::Setup();
+
+	// "-server" (or "-headless") runs a dedicated server without window, graphics or UI. "-port" overrides the UDP port.
+	// "-bots N" runs N headless painters against "-address" instead, drawing "-botrate" circles per second each,
+	// uniformly over the table or around a spot per bot with "-botcluster".
+	// "-statsfile" exports draw latency statistics every "-statsinterval" seconds, as JSON lines if it ends with .json
+	// "-parallelfanout" encodes confirm batches filtered by region of interest on the worker threads with 16
+	// clients or more
+	// "-baselinedelta" sends confirms unreliably as deltas against what each client acknowledged
+	// "-sendbudget" limits what is sent to each client to the given KB per second, confirms first and snapshots with the rest
+	// "-adaptiverate" flushes each client less often while its link shows congestion
+	// "-requestrate" admits at most the given draw requests per second from each client, "-requestburst" at once
+	// "-tickrate" sets the fixed rate at which the dedicated server applies draw requests, independent of frames
+	// "-decodethread" decodes draw requests on a thread of their own, handing them to the network update without locks
+	// "-drawlog" appends confirmed draw commands to the given file and continues the table from it when the server starts
+	// "-historyhorizon" sets how many broadcast draw commands the server keeps for deltas and replay before folding them
+	// "-antialias" draws circles with anti-aliased edges. Server and clients must agree on it
+	const Vector<String>& arguments = GetArguments();
+	for (unsigned i = 0; i < arguments.Size(); ++i)
+	{
+		String argument = arguments[i].ToLower();
+		bool hasValue = i + 1 < arguments.Size();
+		if (argument == "-server" || argument == "-headless" || argument == "--headless")
+			headless_ = true;
+		else if (argument == "-port" && hasValue)
+			serverPort_ = (unsigned short)ToUInt(arguments[++i]);
+		else if (argument == "-address" && hasValue)
+			serverAddress_ = arguments[++i];
+		else if (argument == "-bots" && hasValue)
+			numBots_ = ToUInt(arguments[++i]);
+		else if (argument == "-botrate" && hasValue)
+			botRate_ = ToFloat(arguments[++i]);
+		else if (argument == "-botcluster")
+			botDistribution_ = BD_CLUSTERED;
+		else if (argument == "-statsfile" && hasValue)
+			statsFile_ = arguments[++i];
+		else if (argument == "-statsinterval" && hasValue)
+			statsInterval_ = ToFloat(arguments[++i]);
+		else if (argument == "-parallelfanout")
+			parallelFanout_ = true;
+		else if (argument == "-baselinedelta")
+			baselineDeltas_ = true;
+		else if (argument == "-sendbudget" && hasValue)
+			sendBudget_ = ToFloat(arguments[++i]) * 1024.0f;
+		else if (argument == "-adaptiverate")
+			adaptiveRate_ = true;
+		else if (argument == "-requestrate" && hasValue)
+			requestRate_ = ToFloat(arguments[++i]);
+		else if (argument == "-requestburst" && hasValue)
+			requestBurst_ = ToFloat(arguments[++i]);
+		else if (argument == "-tickrate" && hasValue)
+			tickRate_ = Max(ToFloat(arguments[++i]), 1.0f);
+		else if (argument == "-decodethread")
+			decodeThread_ = true;
+		else if (argument == "-drawlog" && hasValue)
+			drawLogFile_ = arguments[++i];
+		else if (argument == "-historyhorizon" && hasValue)
+			historyHorizon_ = ToUInt(arguments[++i]);
+		else if (argument == "-antialias")
+			antiAlias_ = true;
+	}
+
+	engineParameters_["Headless"] = headless_ || numBots_ > 0;
+}
+
 void SceneReplication::Start()
 {
-	context_->RegisterSubsystem(new Console(context_));
+	if (!headless_ && !numBots_)
+		context_->RegisterSubsystem(new Console(context_));
+
+	DrawStats* stats = new DrawStats(context_);
+	stats->SetExportFile(statsFile_);
+	stats->SetExportInterval(statsInterval_);
+	context_->RegisterSubsystem(stats);
+	// Outgoing messages are built in pooled buffers
+	context_->RegisterSubsystem(new MessagePool(context_));
+	admission_.SetLimits(requestRate_, requestBurst_);
 
     // Execute base class startup
     Sample::Start();
 
+	if (numBots_)
+	{
+		loadGenerator_ = new LoadGenerator(context_);
+		loadGenerator_->SetRate(botRate_);
+		loadGenerator_->SetDistribution(botDistribution_);
+		loadGenerator_->Start(serverAddress_, serverPort_, numBots_);
+		return;
+	}
+
     // Create the scene content
     CreateScene();
 
+	if (headless_)
+	{
+		SubscribeToEvents();
+		StartServer();
+		return;
+	}
+
     // Create the UI content
     CreateUI();
 
@@ -109,6 +214,14 @@ void SceneReplication::Start()
 
 void SceneReplication::Stop()
 {
+	loadGenerator_.Reset();
+	decoder_.Shutdown();
+	// Restarting from a checkpoint taken now replays nothing
+	if (drawLog_)
+	{
+		drawLog_->WriteCheckpoint(table_, tick_);
+		drawLog_->Close();
+	}
 	GetSubsystem<Log>()->Close();
 }
 
@@ -132,6 +245,20 @@ void SceneReplication::CreateScene()
     zone->SetFogStart(100.0f);
     zone->SetFogEnd(300.0f);	
 
+	// CPU side table. Modified pixels are uploaded to the texture once per frame
+	table_ = new DrawingTable(context_);
+	table_->SetAntiAlias(antiAlias_);
+	history_ = new DrawHistory(context_);
+	history_->SetHorizon(historyHorizon_);
+
+	// A dedicated server keeps the table as an image only
+	if (headless_)
+		return;
+
+	// What is displayed is the table plus own circles the server has not confirmed yet
+	prediction_ = new PredictionLayer(context_);
+	prediction_->SetTable(table_);
+
     // Create a "floor" consisting of several tiles. Make the tiles physical but leave small cracks between them
     Node* tableNode = scene_->CreateChild("Table", LOCAL);
 	tableNode->SetPosition(Vector3(0.0f, 0.0f, 10.0f));
@@ -144,16 +271,6 @@ void SceneReplication::CreateScene()
 	tableTexture_ = SharedPtr<Texture2D>(new Texture2D(context_));
 	tableTexture_->SetSize(DRAWING_TABLE_SIZE, DRAWING_TABLE_SIZE, Graphics::GetRGBFormat(), TEXTURE_DYNAMIC);
 	tableTexture_->SetFilterMode(FILTER_NEAREST);
-	char* c = new char[DRAWING_TABLE_SIZE * DRAWING_TABLE_SIZE * 3];
-	for (int x = 0; x < DRAWING_TABLE_SIZE * 3; x += 3)
-		for (int y = 0; y < DRAWING_TABLE_SIZE * 3; y += 3)
-		{
-			c[x + y * DRAWING_TABLE_SIZE] = 64;
-			c[x + 1 + y * DRAWING_TABLE_SIZE] = 64;
-			c[x + 2 + y * DRAWING_TABLE_SIZE] = 64;
-		}
-	tableTexture_->SetData(0, 0, 0, DRAWING_TABLE_SIZE, DRAWING_TABLE_SIZE, c);
-	delete c;
 	
 	// Create a new material from scratch, use the diffuse unlit technique, assign the render texture
 	// as its diffuse texture, then assign the material to the screen plane object
@@ -241,9 +358,14 @@ void SceneReplication::SubscribeToEvents()
     SubscribeToEvent(E_POSTUPDATE, URHO3D_HANDLER(SceneReplication, HandlePostUpdate));
 
     // Subscribe to button actions
-    SubscribeToEvent(connectButton_, E_RELEASED, URHO3D_HANDLER(SceneReplication, HandleConnect));
-    SubscribeToEvent(disconnectButton_, E_RELEASED, URHO3D_HANDLER(SceneReplication, HandleDisconnect));
-    SubscribeToEvent(startServerButton_, E_RELEASED, URHO3D_HANDLER(SceneReplication, HandleStartServer));
+	if (!headless_)
+	{
+		SubscribeToEvent(connectButton_, E_RELEASED, URHO3D_HANDLER(SceneReplication, HandleConnect));
+		SubscribeToEvent(disconnectButton_, E_RELEASED, URHO3D_HANDLER(SceneReplication, HandleDisconnect));
+		SubscribeToEvent(startServerButton_, E_RELEASED, URHO3D_HANDLER(SceneReplication, HandleStartServer));
+		// Own clicks are drawn right away and reconciled when the server acknowledges them
+		SubscribeToEvent(E_DRAWPREDICTED, URHO3D_HANDLER(SceneReplication, HandleDrawPredicted));
+	}
 
     // Subscribe to network events
     SubscribeToEvent(E_SERVERCONNECTED, URHO3D_HANDLER(SceneReplication, HandleConnectionStatus));
@@ -253,15 +375,16 @@ void SceneReplication::SubscribeToEvents()
     SubscribeToEvent(E_CLIENTDISCONNECTED, URHO3D_HANDLER(SceneReplication, HandleClientDisconnected));
     // This is a custom event, sent from the server to the client. It tells the node ID of the object the client should control
     SubscribeToEvent(E_CLIENTOBJECTID, URHO3D_HANDLER(SceneReplication, HandleClientObjectID));
-	// This is a custom event, sent from the client to the server. It tells to the server where to draw circle
-	SubscribeToEvent(E_DRAWCOMMAND_REQUEST, URHO3D_HANDLER(SceneReplication, HandleDrawCommandRequest));
-	// This is a custom event, sent from the server to the client. It tells to the client where to draw circle
-	SubscribeToEvent(E_DRAWCOMMAND_CONFIRM, URHO3D_HANDLER(SceneReplication, HandleDrawCommandConfirmed));
+	// Draw command batches are custom messages, sent from the client to the server and back
+	SubscribeToEvent(E_NETWORKMESSAGE, URHO3D_HANDLER(SceneReplication, HandleNetworkMessage));
+	// Confirmed draw commands are broadcast once per network tick
+	SubscribeToEvent(E_NETWORKUPDATE, URHO3D_HANDLER(SceneReplication, HandleNetworkUpdate));
+	// The dedicated server applies draw requests at a fixed tick rate, otherwise once per network update
+	if (headless_)
+		SubscribeToEvent(E_UPDATE, URHO3D_HANDLER(SceneReplication, HandleServerTick));
 
     // Events sent between client & server (remote events) must be explicitly registered or else they are not allowed to be received
     GetSubsystem<Network>()->RegisterRemoteEvent(E_CLIENTOBJECTID);
-	GetSubsystem<Network>()->RegisterRemoteEvent(E_DRAWCOMMAND_REQUEST);
-	GetSubsystem<Network>()->RegisterRemoteEvent(E_DRAWCOMMAND_CONFIRM);
 }
 
 Button* SceneReplication::CreateButton(const String& text, int width)
@@ -283,6 +406,9 @@ Button* SceneReplication::CreateButton(const String& text, int width)
 
 void SceneReplication::UpdateButtons()
 {
+	if (headless_)
+		return;
+
     Network* network = GetSubsystem<Network>();
     Connection* serverConnection = network->GetServerConnection();
     bool serverRunning = network->IsServerRunning();
@@ -334,11 +460,56 @@ void SceneReplication::CheckAuthority()
 
 void SceneReplication::HandlePostUpdate(StringHash eventType, VariantMap& eventData)
 {
+	CheckAuthority();
+
+	if (headless_)
+		return;
+
 	Input* input = GetSubsystem<Input>();
 	if (input->GetKeyDown(KEY_F1))
 		GetSubsystem<Console>()->Toggle();
 
-	CheckAuthority();
+	SendInterestRegion();
+
+	// One texture upload for everything drawn this frame
+	UploadTable();
+}
+
+void SceneReplication::HandleServerTick(StringHash eventType, VariantMap& eventData)
+{
+	using namespace Update;
+
+	if (!GetSubsystem<Network>()->IsServerRunning())
+		return;
+
+	float interval = 1.0f / tickRate_;
+	tickAcc_ += eventData[P_TIMESTEP].GetFloat();
+	for (unsigned i = 0; i < MAX_TICKS_PER_FRAME && tickAcc_ >= interval; ++i)
+	{
+		RunTick(interval);
+		tickAcc_ -= interval;
+	}
+	tickAcc_ = Min(tickAcc_, interval);
+}
+
+void SceneReplication::RunTick(float timeStep)
+{
+	// Everything decoded by now belongs to this tick, in the order the decoder produced it
+	ApplyDecodedRequests(timeStep);
+	++tick_;
+
+	// The commands of a tick are committed together, with a checkpoint now and then to bound the replay on restart
+	if (drawLog_)
+	{
+		drawLog_->Commit();
+		if (drawLog_->IsCheckpointDue())
+			drawLog_->WriteCheckpoint(table_, tick_);
+		if (!drawLog_->IsOpen())
+		{
+			URHO3D_LOGERROR("Draw logging stopped until the server is restarted");
+			drawLog_.Reset();
+		}
+	}
 }
 
 void SceneReplication::HandleConnect(StringHash eventType, VariantMap& eventData)
@@ -350,7 +521,17 @@ void SceneReplication::HandleConnect(StringHash eventType, VariantMap& eventData
 
     // Connect to server, specify scene to use as a client for replication
     clientObjectID_ = 0; // Reset own object ID from possible previous connection
-    network->Connect(address, SERVER_PORT, scene_);
+	// The server sends a table snapshot on connect
+	tableSequence_ = 0;
+	tableTick_ = 0;
+	tableBands_ = 0;
+	requestAck_ = 0;
+	pendingDeltas_.Reset();
+	table_->Clear();
+	prediction_->Clear();
+	// The server subscribes new clients to the whole table. A view off the table snaps to an empty region and is still sent
+	interestRegion_ = IntRect(0, 0, DRAWING_TABLE_SIZE, DRAWING_TABLE_SIZE);
+    network->Connect(address, serverPort_, scene_);
 
     UpdateButtons();
 }
@@ -367,27 +548,73 @@ void SceneReplication::HandleDisconnect(StringHash eventType, VariantMap& eventD
         scene_->Clear(true, false);
         clientObjectID_ = 0;
 		clientObjectAuth_ = false;
+		prediction_->Clear();
     }
     // Or if we were running a server, stop it
     else if (network->IsServerRunning())
     {
+		// Stopping frees the connections without a disconnect event for each, so forget the clients while they exist.
+		// Requests still queued for decoding belong to them
+		while (!clientHandles_.Empty())
+			RemoveClient(clientHandles_.Begin()->first_);
+		decoder_.Reset();
         network->StopServer();
         scene_->Clear(true, false);
+		broadcastStart_ = history_->GetEnd();
     }
 
     UpdateButtons();
 }
 
 void SceneReplication::HandleStartServer(StringHash eventType, VariantMap& eventData)
+{
+	StartServer();
+}
+
+void SceneReplication::StartServer()
 {
     Network* network = GetSubsystem<Network>();
-    network->StartServer(SERVER_PORT);
+	if (network->StartServer(serverPort_))
+	{
+		URHO3D_LOGINFO(ToString("Server started on port %d", serverPort_));
+		if (!drawLogFile_.Empty() && !drawLog_)
+			OpenDrawLog();
+		if (decodeThread_ && !decoder_.Start())
+			URHO3D_LOGERROR("Failed to start draw request decoder thread, decoding on the main thread");
+	}
+	else
+		URHO3D_LOGERROR(ToString("Failed to start server on port %d", serverPort_));
 
     UpdateButtons();
 }
 
+void SceneReplication::OpenDrawLog()
+{
+	drawLog_ = new DrawLog(context_);
+	if (!drawLog_->Open(drawLogFile_))
+	{
+		drawLog_.Reset();
+		return;
+	}
+	if (!drawLog_->GetNumRecords())
+		return;
+
+	// Everything logged was confirmed before, so the history continues after it with nothing to broadcast
+	unsigned tick;
+	if (!drawLog_->Restore(table_, tick))
+		return;
+	history_->Restart(table_, drawLog_->GetNumRecords());
+	broadcastStart_ = history_->GetEnd();
+	snapshotMessages_.Clear();
+	tick_ = tick;
+}
+
 void SceneReplication::HandleConnectionStatus(StringHash eventType, VariantMap& eventData)
 {
+	// Nothing will acknowledge predictions after losing the server
+	if (prediction_ && !GetSubsystem<Network>()->GetServerConnection())
+		prediction_->Clear();
+
     UpdateButtons();
 }
 
@@ -401,20 +628,25 @@ void SceneReplication::HandleClientConnected(StringHash eventType, VariantMap& e
 
     // Then create a controllable object for that client
     Node* newObject = CreateControllableObject();
-    serverObjects_[newConnection] = newObject;
+    ClientState state;
+    state.connection_ = newConnection;
+    state.object_ = newObject;
+	state.painter_ = newObject->GetComponent<CirclePainter>();
+	// Interested in the whole table until the client reports what it sees
+	state.interestID_ = interest_.Subscribe(IntRect(0, 0, DRAWING_TABLE_SIZE, DRAWING_TABLE_SIZE));
+	state.scheduler_.SetConnection(newConnection);
+	state.scheduler_.SetBudget(sendBudget_);
+	state.flushRate_.SetMaxRate((float)GetSubsystem<Network>()->GetUpdateFps());
+	unsigned handle = clients_.Insert(state);
+	clientHandles_[newConnection] = handle;
 
     // Finally send the object's node ID using a remote event
     VariantMap remoteEventData;
     remoteEventData[P_ID] = newObject->GetID();
     newConnection->SendRemoteEvent(E_CLIENTOBJECTID, true, remoteEventData);
 
-	for (auto it = history.Begin(); it != history.End(); ++it)
-	{
-		VariantMap remoteEventData;
-		remoteEventData[P_DC_POSITION] = it->position;
-		remoteEventData[P_DC_COLOR] = it->color;
-		newConnection->SendRemoteEvent(E_DRAWCOMMAND_CONFIRM, true, remoteEventData);
-	}
+	// Send the table as it is now. Commands of the current tick will arrive with the next broadcast
+	SendTableSnapshot(*clients_.Get(handle));
 }
 
 void SceneReplication::HandleClientDisconnected(StringHash eventType, VariantMap& eventData)
@@ -422,12 +654,23 @@ void SceneReplication::HandleClientDisconnected(StringHash eventType, VariantMap
     using namespace ClientConnected;
 
     // When a client disconnects, remove the controlled object
-    Connection* connection = static_cast<Connection*>(eventData[P_CONNECTION].GetPtr());
-    Node* object = serverObjects_[connection];
-    if (object)
-        object->Remove();
+    RemoveClient(static_cast<Connection*>(eventData[P_CONNECTION].GetPtr()));
+}
 
-    serverObjects_.Erase(connection);
+void SceneReplication::RemoveClient(Connection* connection)
+{
+	HashMap<Connection*, unsigned>::Iterator i = clientHandles_.Find(connection);
+	if (i != clientHandles_.End())
+	{
+		ClientState* state = clients_.Get(i->second_);
+		if (state->object_)
+			state->object_->Remove();
+
+		interest_.Unsubscribe(state->interestID_);
+		clients_.Erase(i->second_);
+		clientHandles_.Erase(i);
+	}
+	GetSubsystem<DrawStats>()->RemoveConnection(connection);
 }
 
 void SceneReplication::HandleClientObjectID(StringHash eventType, VariantMap& eventData)
@@ -435,77 +678,686 @@ void SceneReplication::HandleClientObjectID(StringHash eventType, VariantMap& ev
     clientObjectID_ = eventData[P_ID].GetUInt();
 }
 
-void SceneReplication::DrawCircle(const Vector2& drawAt, const Color& color)
+void SceneReplication::UploadTable()
 {
-	const int diameter = 10;
+	// Confirmed changes and resolved predictions are composited first, the upload covers both
+	IntRect rect = prediction_->Compose();
+	if (rect.right_ <= rect.left_)
+		return;
 
-	float readlbounds = (DRAWING_TABLE_SIZE)* PIXEL_SIZE / 2.0f;
+	DrawingTable* display = prediction_->GetDisplay();
+	int width = rect.Width();
+	int height = rect.Height();
 
-	IntVector2 coord = IntVector2((drawAt.x_ + readlbounds) / PIXEL_SIZE, DRAWING_TABLE_SIZE - (drawAt.y_ + readlbounds) / PIXEL_SIZE);
+	// Full width rows are contiguous in the table image, anything else is packed first
+	if (width == DRAWING_TABLE_SIZE)
+	{
+		tableTexture_->SetData(0, 0, rect.top_, width, height, display->GetPixels(0, rect.top_));
+		return;
+	}
+
+	unsigned rowSize = width * DRAWING_TABLE_COMPONENTS;
+	uploadBuffer_.Resize(rowSize * height);
+	for (int y = 0; y < height; ++y)
+		memcpy(&uploadBuffer_[y * rowSize], display->GetPixels(rect.left_, rect.top_ + y), rowSize);
+	tableTexture_->SetData(0, rect.left_, rect.top_, width, height, &uploadBuffer_[0]);
+}
 
-	if (coord.x_ <= 0 || coord.x_ > DRAWING_TABLE_SIZE || coord.y_ <= 0 || coord.y_ > DRAWING_TABLE_SIZE)
+void SceneReplication::SendTableSnapshot(ClientState& state)
+{
+	// Recompress only when enough commands have been applied since the cached snapshot. Until then joining
+	// clients get the cached snapshot followed by the commands issued after it, as long as those are still retained
+	if (snapshotMessages_.Empty() || snapshotSequence_ < history_->GetBegin() ||
+		history_->GetEnd() - snapshotSequence_ >= SNAPSHOT_REFRESH_COMMANDS)
+	{
+		// Bands the table has not touched since the previous snapshot keep their compressed data
+		bool rebuildAll = snapshotMessages_.Empty();
+		snapshotMessages_.Resize(NUM_SNAPSHOT_BANDS);
+		snapshotSequence_ = history_->GetEnd();
+		snapshotTick_ = tick_;
+		const DirtyMask& dirtyBands = table_->GetDirtyBands();
+		for (unsigned band = 0; band < NUM_SNAPSHOT_BANDS; ++band)
+		{
+			VectorBuffer& msg = snapshotMessages_[band];
+			if (rebuildAll || dirtyBands.IsSet(band))
+			{
+				msg.Clear();
+				msg.WriteUInt(snapshotSequence_);
+				msg.WriteUInt(snapshotTick_);
+				table_->WriteSnapshotBand(msg, band * SNAPSHOT_BAND_ROWS, SNAPSHOT_BAND_ROWS);
+			}
+			else
+			{
+				msg.Seek(0);
+				msg.WriteUInt(snapshotSequence_);
+				msg.WriteUInt(snapshotTick_);
+			}
+		}
+		table_->ClearDirtyBands();
+	}
+
+	for (unsigned i = 0; i < snapshotMessages_.Size(); ++i)
+		state.scheduler_.Send(MSG_TABLESNAPSHOT, true, snapshotMessages_[i], SP_BULK);
+	state.numBands_ += snapshotMessages_.Size();
+
+	// In baseline delta mode the commands after the snapshot go with the next delta
+	state.baseline_ = snapshotSequence_;
+	if (!baselineDeltas_)
+		SendDrawCommands(state, snapshotSequence_, broadcastStart_);
+}
+
+void SceneReplication::WriteDrawCommands(VectorBuffer& msg, unsigned start, unsigned end) const
+{
+	DrawConfirmWriter writer(msg, start, start < end ? history_->Get(start).tick : tick_, end - start);
+	writer.BeginRun(0, end - start);
+	for (unsigned i = start; i < end; ++i)
+		writer.Write(history_->Get(i));
+	writer.Finish();
+}
+
+void SceneReplication::WriteDrawCommands(VectorBuffer& msg, const unsigned* sequences, unsigned count) const
+{
+	WriteDrawConfirms(msg, *history_, sequences, count, tick_);
+}
+
+void SceneReplication::SendDrawCommands(ClientState& state, unsigned start, unsigned end)
+{
+	PooledMessage msg(GetSubsystem<MessagePool>(), Min(end - start, MAX_DRAWCOMMANDS_PER_BATCH) * DRAWCOMMAND_RESERVE_SIZE);
+	for (unsigned i = start; i < end; i += MAX_DRAWCOMMANDS_PER_BATCH)
+	{
+		msg->Clear();
+		WriteDrawCommands(*msg, i, Min(i + MAX_DRAWCOMMANDS_PER_BATCH, end));
+		state.scheduler_.Send(MSG_DRAWCONFIRMBATCH, true, *msg, SP_CONFIRM);
+	}
+}
+
+void SceneReplication::HandleNetworkMessage(StringHash eventType, VariantMap& eventData)
+{
+	using namespace NetworkMessage;
+
+	int msgID = eventData[P_MESSAGEID].GetInt();
+	Network* network = GetSubsystem<Network>();
+	Connection* connection = static_cast<Connection*>(eventData[P_CONNECTION].GetPtr());
+	MemoryBuffer msg(eventData[P_DATA].GetBuffer());
+
+	// Messages are accepted in their direction only, so a client can not draw into or overwrite the server's table
+	if (network->IsServerRunning())
+	{
+		if (msgID == MSG_DRAWREQUESTBATCH)
+			HandleDrawRequestBatch(connection, msg);
+		else if (msgID == MSG_INTERESTREGION)
+			HandleInterestRegion(connection, msg);
+		else if (msgID == MSG_DRAWDELTAACK)
+			HandleDrawDeltaAck(connection, msg);
+		return;
+	}
+	if (connection != network->GetServerConnection())
+		return;
+
+	if (msgID == MSG_DRAWCONFIRMBATCH)
+		HandleDrawConfirmBatch(connection, msg);
+	else if (msgID == MSG_TABLESNAPSHOT)
+		HandleTableSnapshot(connection, msg);
+	else if (msgID == MSG_DRAWREQUESTACK)
+		HandleDrawRequestAck(connection, msg);
+	else if (msgID == MSG_DRAWCONFIRMDELTA)
+		HandleDrawConfirmDelta(connection, msg);
+}
+
+void SceneReplication::HandleNetworkUpdate(StringHash eventType, VariantMap& eventData)
+{
+	Network* network = GetSubsystem<Network>();
+	if (!network->IsServerRunning())
+	{
+		// Held back deltas still not applicable are covered by the server's next delta
+		pendingDeltas_.Reset();
 		return;
+	}
+
+	for (unsigned i = 0; i < catchUpBands_.Size(); ++i)
+		catchUpBands_[i].Clear();
+
+	float timeStep = 1.0f / Max(network->GetUpdateFps(), 1);
+	if (!headless_)
+		RunTick(timeStep);
+
+	// What waited for budget goes before anything new. Clients not due a flush get their messages queued until they are
+	for (unsigned i = 0; i < clients_.Size(); ++i)
+	{
+		if (adaptiveRate_)
+			UpdateFlushRate(clients_[i], timeStep);
+		clients_[i].scheduler_.Update(timeStep);
+	}
+
+	if (baselineDeltas_)
+	{
+		// Region changes restart baselines at the current pixels, so the deltas follow them. Acknowledgements ride along
+		// with the deltas
+		UpdateInterestRegions();
+		SendDrawDeltas();
+	}
+	else if (broadcastStart_ != history_->GetEnd())
+	{
+		// Everything confirmed since the previous tick. While no client limits its region of interest, the same messages go to all
+		if (interest_.IsUnfiltered())
+		{
+			PooledMessage msg(GetSubsystem<MessagePool>(),
+				Min(history_->GetEnd() - broadcastStart_, MAX_DRAWCOMMANDS_PER_BATCH) * DRAWCOMMAND_RESERVE_SIZE);
+			for (unsigned i = broadcastStart_; i < history_->GetEnd(); i += MAX_DRAWCOMMANDS_PER_BATCH)
+			{
+				msg->Clear();
+				WriteDrawCommands(*msg, i, Min(i + MAX_DRAWCOMMANDS_PER_BATCH, history_->GetEnd()));
+				for (unsigned j = 0; j < clients_.Size(); ++j)
+					clients_[j].scheduler_.Send(MSG_DRAWCONFIRMBATCH, true, *msg, SP_CONFIRM);
+			}
+		}
+		else
+			SendFilteredDrawCommands(broadcastStart_, history_->GetEnd());
+	}
+
+	if (broadcastStart_ != history_->GetEnd())
+	{
+		broadcastStart_ = history_->GetEnd();
+		GetSubsystem<DrawStats>()->RequestsBroadcast();
+
+		// Broadcast commands older than the horizon are no longer needed individually. Clients whose baseline falls behind
+		// are resynchronized from the table
+		if (history_->Compact(broadcastStart_))
+			GetSubsystem<DrawStats>()->HistorySampled(history_->GetSize(), history_->GetBytesReclaimed());
+	}
+
+	// Rather than let a backlog grow without bound, a client too far behind starts over from the current pixels
+	ResyncOverflowingClients();
+
+	if (!baselineDeltas_)
+	{
+		// Catch-up pixels and acknowledgements follow the confirms on the same ordered channel, so predictions resolve
+		// against an up to date table
+		UpdateInterestRegions();
+		SendRequestAcks();
+	}
 
-	char* data = new char[diameter * 3];
-	for (int i = 0; i < diameter * 3; i += 3)
+	DrawStats* stats = GetSubsystem<DrawStats>();
+	for (unsigned i = 0; i < clients_.Size(); ++i)
 	{
-		data[i] = color.r_ * 255;
-		data[i + 1] = color.g_ * 255;
-		data[i + 2] = color.b_ * 255;
+		const SendScheduler& scheduler = clients_[i].scheduler_;
+		stats->SendQueueSampled(clients_[i].connection_, scheduler.GetQueueDepth(), scheduler.GetQueuedBytes(),
+			scheduler.GetDeferredBytes(), scheduler.GetDroppedBytes());
+		if (adaptiveRate_)
+			stats->FlushRateSampled(clients_[i].connection_, clients_[i].flushRate_.GetRate(), clients_[i].flushRate_.GetNumBackoffs());
 	}
+}
+
+void SceneReplication::UpdateFlushRate(ClientState& state, float timeStep)
+{
+	// Queue depth is what kNet has not yet put on the wire, messages held here for the next flush do not count
+	kNet::MessageConnection* link = state.connection_->GetMessageConnection();
+	float lossRate = 0.0f;
+	if (link->GetSocket() && link->GetSocket()->TransportLayer() == kNet::SocketOverUDP)
+		lossRate = static_cast<kNet::UDPMessageConnection*>(link)->PacketLossRate();
+
+	FlushRate& flushRate = state.flushRate_;
+	bool due = flushRate.Update(timeStep, link->RoundTripTime(), lossRate, (unsigned)link->NumOutboundMessagesPending());
+	state.scheduler_.SetHold(!due);
 
-	int r = diameter / 2;
+	if (flushRate.IsRateChanged())
 	{
-		int x1;
-		int x2;
-		int counter = (coord.y_ + r);
-		for (int line = (coord.y_ - r); line <= counter; line++)
+		URHO3D_LOGDEBUG(ToString("%s flushing at %.1f Hz%s", state.connection_->ToString().CString(), flushRate.GetRate(),
+			flushRate.IsCongested() ? " after congestion" : ""));
+
+		using namespace ClientFlushRate;
+		VariantMap& eventData = GetEventDataMap();
+		eventData[P_CONNECTION] = state.connection_;
+		eventData[P_RATE] = flushRate.GetRate();
+		eventData[P_CONGESTED] = flushRate.IsCongested();
+		SendEvent(E_CLIENTFLUSHRATE, eventData);
+	}
+}
+
+void SceneReplication::SendDrawDeltas()
+{
+	unsigned end = history_->GetEnd();
+	PooledMessage msg(GetSubsystem<MessagePool>(), MAX_DRAWCOMMANDS_PER_DELTA * DRAWCOMMAND_RESERVE_SIZE);
+	for (unsigned i = 0; i < clients_.Size(); ++i)
+	{
+		ClientState& state = clients_[i];
+		// Everything since the baseline goes out with the next flush anyway
+		if (state.scheduler_.IsHeld())
+			continue;
+
+		// Commands before the baseline have been folded into the keyframe, and a client too far behind would get the
+		// whole span again every update, so restart from the current pixels
+		if (state.baseline_ < history_->GetBegin() || end - state.baseline_ > MAX_DELTA_SPAN)
+		{
+			SendCatchUpBands(state, IntRect::ZERO);
+			state.baseline_ = end;
+		}
+		if (state.baseline_ == end && state.ackedRequest_ == state.lastRequest_)
+			continue;
+
+		// Everything the client has not acknowledged is sent again, so a lost delta needs no resend of its own
+		const IntRect& region = interest_.GetRegion(state.interestID_);
+		deltaSelection_.Clear();
+		for (unsigned j = state.baseline_; j < end; ++j)
 		{
-			x1 = int(coord.x_ + sqrt((r*r) - ((line - coord.y_)*(line - coord.y_))) + 0.5);
-			x2 = int(coord.x_ - sqrt((r*r) - ((line - coord.y_)*(line - coord.y_))) + 0.5);
-			x1 = Clamp(x1, 0, DRAWING_TABLE_SIZE);
-			x2 = Clamp(x2, 0, DRAWING_TABLE_SIZE);
-			if (x1 <= x2)
-				continue;
-			URHO3D_LOGDEBUG(Urho3D::ToString("SetData(%d, %d, %d, %d, %d)", 0, x2, line, x1 - x2, 1));
-			tableTexture_->SetData(0, x2, line, x1 - x2, 1, data);
+			IntRect rect = table_->GetCircleRect(history_->Get(j).position);
+			if (rect.left_ < region.right_ && rect.right_ > region.left_ && rect.top_ < region.bottom_ && rect.bottom_ > region.top_)
+				deltaSelection_.Push(j);
 		}
+
+		// Each message continues where the previous one ends, so the client applies them in order or waits for the next
+		// delta. The request acknowledgement goes with the last, after the commands it covers
+		DrawDeltaHeader header;
+		header.base_ = state.baseline_;
+		header.numBands_ = state.numBands_;
+		unsigned first = 0;
+		do
+		{
+			unsigned count = Min(deltaSelection_.Size() - first, MAX_DRAWCOMMANDS_PER_DELTA);
+			bool last = first + count == deltaSelection_.Size();
+			header.end_ = last ? end : deltaSelection_[first + count];
+			header.lastRequest_ = last ? state.lastRequest_ : 0;
+
+			msg->Clear();
+			header.Write(*msg);
+			WriteDrawCommands(*msg, count ? &deltaSelection_[first] : 0, count);
+			state.scheduler_.Send(MSG_DRAWCONFIRMDELTA, false, *msg, SP_CONFIRM);
+
+			header.base_ = header.end_;
+			first += count;
+		} while (first < deltaSelection_.Size());
 	}
-	delete data;
 }
 
-void SceneReplication::HandleDrawCommandRequest(StringHash eventType, VariantMap& eventData)
+void SceneReplication::SendFilteredDrawCommands(unsigned start, unsigned end)
 {
-	unsigned int	drawBy = eventData[P_ID].GetUInt();
-	Vector2		drawAt = eventData[P_DC_POSITION].GetVector2();
+	fanout_.Resize(interest_.GetMaxGroups());
+	for (unsigned i = start; i < end; ++i)
+	{
+		interest_.Query(table_->GetCircleRect(history_->Get(i).position), interestQuery_);
+		for (unsigned j = 0; j < interestQuery_.Size(); ++j)
+			fanout_[interestQuery_[j]].selection_.Push(i);
+	}
 
-	Node* node = scene_->GetNode(drawBy);
-	if (!node)
+	// Only groups with commands are worth a work item. Many clients usually share a few regions
+	fanoutWork_.Clear();
+	for (unsigned i = 0; i < fanout_.Size(); ++i)
+	{
+		if (fanout_[i].selection_.Empty())
+			fanout_[i].numMessages_ = 0;
+		else
+			fanoutWork_.Push(&fanout_[i]);
+	}
+
+	// Few clients gain nothing from the worker threads
+	WorkQueue* queue = GetSubsystem<WorkQueue>();
+	EncodeInterestFanouts(fanoutWork_, *history_, parallelFanout_ && clients_.Size() >= MIN_PARALLEL_FANOUT ? queue : 0);
+
+	// Submit on the main thread in connection order, so what is sent does not depend on the threads. Connections with
+	// equal regions send the same encoded buffers
+	for (unsigned i = 0; i < clients_.Size(); ++i)
+	{
+		const InterestFanout& fanout = fanout_[clients_[i].interestID_];
+		for (unsigned j = 0; j < fanout.numMessages_; ++j)
+			clients_[i].scheduler_.Send(MSG_DRAWCONFIRMBATCH, true, fanout.messages_[j], SP_CONFIRM);
+	}
+	for (unsigned i = 0; i < fanout_.Size(); ++i)
+		fanout_[i].selection_.Clear();
+}
+
+void SceneReplication::UpdateInterestRegions()
+{
+	for (unsigned i = 0; i < clients_.Size(); ++i)
+	{
+		ClientState& state = clients_[i];
+		if (!state.regionPending_)
+			continue;
+
+		IntRect oldRegion = interest_.GetRegion(state.interestID_);
+		unsigned newID = interest_.Subscribe(state.pendingRegion_);
+		interest_.Unsubscribe(state.interestID_);
+		state.interestID_ = newID;
+		state.regionPending_ = false;
+
+		// Every command before the current end of history has been broadcast, so no command needs to follow the bands.
+		// A client on deltas may still lack some, so its whole region restarts from the bands
+		if (baselineDeltas_)
+		{
+			SendCatchUpBands(state, IntRect::ZERO);
+			state.baseline_ = history_->GetEnd();
+		}
+		else
+			SendCatchUpBands(state, oldRegion);
+	}
+}
+
+void SceneReplication::SendCatchUpBands(ClientState& state, const IntRect& oldRegion)
+{
+	// Bands are compressed once per update however many clients need them. Buffers are kept to reuse their memory
+	if (catchUpBands_.Empty())
+		catchUpBands_.Resize(DRAWING_TABLE_SIZE / SNAPSHOT_BAND_ROWS);
+
+	// Bands reaching outside the old region are sent as they are now
+	const IntRect& region = interest_.GetRegion(state.interestID_);
+	for (int row = 0; row < DRAWING_TABLE_SIZE; row += SNAPSHOT_BAND_ROWS)
+	{
+		IntRect part(region.left_, Max(region.top_, row), region.right_, Min(region.bottom_, row + SNAPSHOT_BAND_ROWS));
+		if (part.right_ <= part.left_ || part.bottom_ <= part.top_)
+			continue;
+		if (part.left_ >= oldRegion.left_ && part.right_ <= oldRegion.right_ && part.top_ >= oldRegion.top_ &&
+			part.bottom_ <= oldRegion.bottom_)
+			continue;
+
+		VectorBuffer& band = catchUpBands_[row / SNAPSHOT_BAND_ROWS];
+		if (!band.GetSize())
+		{
+			band.WriteUInt(history_->GetEnd());
+			band.WriteUInt(tick_);
+			table_->WriteSnapshotBand(band, row, SNAPSHOT_BAND_ROWS);
+		}
+		state.scheduler_.Send(MSG_TABLESNAPSHOT, true, band, SP_BULK);
+		++state.numBands_;
+	}
+}
+
+void SceneReplication::ResyncOverflowingClients()
+{
+	for (unsigned i = 0; i < clients_.Size(); ++i)
+	{
+		ClientState& state = clients_[i];
+		if (!state.scheduler_.IsOverflowing())
+			continue;
+
+		URHO3D_LOGDEBUG(ToString("%s has %u bytes waiting, resynchronizing", state.connection_->ToString().CString(),
+			state.scheduler_.GetQueuedBytes()));
+
+		// Bands dropped with the backlog never arrive, so deltas must not wait for them. The acknowledgement may have been
+		// dropped too
+		state.numBands_ -= state.scheduler_.GetNumQueued(MSG_TABLESNAPSHOT);
+		state.scheduler_.Clear();
+		SendCatchUpBands(state, IntRect::ZERO);
+		state.baseline_ = history_->GetEnd();
+		state.ackPending_ = true;
+	}
+}
+
+void SceneReplication::HandleInterestRegion(Connection* connection, MemoryBuffer& msg)
+{
+	ClientState* state = GetClient(connection);
+	if (!state)
 		return;
 
-	CirclePainter* p = node->GetComponent<CirclePainter>();
-	if (!p)
+	// Applied with the next broadcast, after which catch-up needs no commands
+	IntRect region;
+	region.left_ = msg.ReadUShort();
+	region.top_ = msg.ReadUShort();
+	region.right_ = msg.ReadUShort();
+	region.bottom_ = msg.ReadUShort();
+	state->pendingRegion_ = region;
+	state->regionPending_ = true;
+}
+
+void SceneReplication::SendInterestRegion()
+{
+	Connection* serverConnection = GetSubsystem<Network>()->GetServerConnection();
+	if (!serverConnection || !serverConnection->IsConnected())
+		return;
+
+	// Orthographic camera looking at the table straight on, so the view is an axis aligned rectangle
+	Camera* camera = cameraNode_->GetComponent<Camera>();
+	float halfHeight = camera->GetOrthoSize() * 0.5f / camera->GetZoom();
+	Vector2 halfSize(halfHeight * camera->GetAspectRatio(), halfHeight);
+	Vector3 cameraPos = cameraNode_->GetWorldPosition();
+	Vector2 topLeft = WorldToTable(Vector2(cameraPos.x_ - halfSize.x_, cameraPos.y_ + halfSize.y_));
+	Vector2 bottomRight = WorldToTable(Vector2(cameraPos.x_ + halfSize.x_, cameraPos.y_ - halfSize.y_));
+
+	// The server snaps regions to whole cells, so only panning into another cell changes the subscription
+	IntRect region = SnapToInterestCells(IntRect((int)floorf(topLeft.x_), (int)floorf(topLeft.y_), (int)ceilf(bottomRight.x_),
+		(int)ceilf(bottomRight.y_)));
+	if (region == interestRegion_)
 		return;
 
-	DrawCommand dc = DrawCommand(drawAt, p->GetColor());
-	history.Push(dc);
-	DrawCircle(dc.position, dc.color);
+	interestRegion_ = region;
+	PooledMessage msg(GetSubsystem<MessagePool>());
+	msg->WriteUShort((unsigned short)region.left_);
+	msg->WriteUShort((unsigned short)region.top_);
+	msg->WriteUShort((unsigned short)region.right_);
+	msg->WriteUShort((unsigned short)region.bottom_);
+	serverConnection->SendMessage(MSG_INTERESTREGION, true, true, *msg);
+}
 
+ClientState* SceneReplication::GetClient(Connection* connection)
+{
+	HashMap<Connection*, unsigned>::ConstIterator i = clientHandles_.Find(connection);
+	return i != clientHandles_.End() ? clients_.Get(i->second_) : 0;
+}
 
-	Network* network = GetSubsystem<Network>();
-	if (!network->IsServerRunning())
+void SceneReplication::SendRequestAcks()
+{
+	PooledMessage msg(GetSubsystem<MessagePool>());
+	for (unsigned i = 0; i < clients_.Size(); ++i)
+	{
+		ClientState& state = clients_[i];
+		if (!state.ackPending_)
+			continue;
+
+		msg->Clear();
+		msg->WriteUInt(state.lastRequest_);
+		state.scheduler_.Send(MSG_DRAWREQUESTACK, true, *msg, SP_CONFIRM);
+		state.ackPending_ = false;
+	}
+}
+
+void SceneReplication::HandleDrawRequestBatch(Connection* connection, MemoryBuffer& msg)
+{
+	HashMap<Connection*, unsigned>::ConstIterator i = clientHandles_.Find(connection);
+	ClientState* state = i != clientHandles_.End() ? clients_.Get(i->second_) : 0;
+	if (!state || !state->painter_)
 		return;
 
-	VariantMap remoteEventData;
-	remoteEventData[P_DC_POSITION] = dc.position;
-	remoteEventData[P_DC_COLOR] = dc.color;
-	network->BroadcastRemoteEvent(E_DRAWCOMMAND_CONFIRM, true, remoteEventData);
+	// Budget is taken on arrival, so requests over it cost no decoding. They are still acknowledged with the batch
+	MemoryBuffer header(msg.GetData(), msg.GetSize());
+	header.ReadUInt();
+	unsigned requested = header.ReadVLE();
+	unsigned admitted = state->requests_.Admit(Min(requested, MAX_DRAWCOMMANDS_PER_BATCH));
+
+	// The table holds exactly what clients will draw from the confirms
+	DrawStats* stats = GetSubsystem<DrawStats>();
+	if (!decoder_.Submit(i->second_, QuantizeDrawColor(state->painter_->GetColor()), stats->GetTime(), admitted,
+		msg.GetData(), msg.GetSize()))
+	{
+		// Not the client's fault, so it keeps its budget
+		state->requests_.Refund(admitted);
+		admitted = 0;
+	}
+	if (admitted < requested)
+		stats->RequestsDropped(connection, requested - admitted);
 }
 
-void SceneReplication::HandleDrawCommandConfirmed(StringHash eventType, VariantMap& eventData)
+void SceneReplication::ApplyDecodedRequests(float timeStep)
 {
-	Vector2		drawAt = eventData[P_DC_POSITION].GetVector2();
-	Color		color = eventData[P_DC_COLOR].GetColor();
+	DrawStats* stats = GetSubsystem<DrawStats>();
+	stats->HandoffSampled(decoder_.GetNumDecoded(), decoder_.GetNumPending());
+	UpdateAdmission(timeStep);
+	float coalesceDistance = admission_.GetCoalesceDistance();
+
+	// Only what is decoded by now, later commands wait for the next tick rather than hold this one up
+	for (unsigned n = decoder_.GetNumDecoded(); n; --n)
+	{
+		const DecodedDraw& draw = *decoder_.GetFront();
+		// Requests of clients that left in the meantime are dropped
+		ClientState* state = clients_.Get(draw.client_);
+		if (state && draw.endOfBatch_)
+		{
+			// Acknowledged after its commands are in the history, so they are broadcast first
+			state->lastRequest_ = draw.lastRequest_;
+			state->ackPending_ = true;
+		}
+		else if (state && state->requests_.Coalesce(WorldToTable(draw.command_.position), coalesceDistance,
+			history_->GetEnd()))
+			stats->RequestCoalesced(state->connection_);
+		else if (state)
+		{
+			stats->RequestReceived(state->connection_, draw.receivedTime_);
+			DrawCommand command(draw.command_.position, draw.command_.color, tick_);
+			history_->Push(command);
+			table_->DrawCircle(command.position, command.color);
+			if (drawLog_)
+				drawLog_->Append(command);
+		}
+		decoder_.PopFront();
+	}
+
+	decoder_.Refill();
+}
+
+void SceneReplication::UpdateAdmission(float timeStep)
+{
+	// Overload shows as requests piling up ahead of the tick, or as what waits to go out to the clients
+	unsigned queueDepth = 0;
+	for (unsigned i = 0; i < clients_.Size(); ++i)
+	{
+		queueDepth += clients_[i].scheduler_.GetQueueDepth();
+		queueDepth += (unsigned)clients_[i].connection_->GetMessageConnection()->NumOutboundMessagesPending();
+	}
+	if (admission_.Update(timeStep, decoder_.GetNumDecoded(), clients_.Size() ? queueDepth / clients_.Size() : 0))
+	{
+		if (admission_.IsOverloaded())
+			URHO3D_LOGWARNING(ToString("Server overloaded, draw requests limited to %.1f/s per client", admission_.GetRate()));
+		else
+			URHO3D_LOGINFO("Server load back to normal, draw request limits restored");
+	}
+	GetSubsystem<DrawStats>()->OverloadSampled(admission_.IsOverloaded(), admission_.GetNumOverloads());
+
+	float rate = admission_.GetRate();
+	float burst = admission_.GetBurst();
+	for (unsigned i = 0; i < clients_.Size(); ++i)
+		clients_[i].requests_.Update(timeStep, rate, burst);
+}
+
+void SceneReplication::HandleDrawConfirmBatch(Connection* connection, MemoryBuffer& msg)
+{
+	DrawStats* stats = GetSubsystem<DrawStats>();
+	DrawConfirmReader reader(msg);
+	DrawCommand dc;
+	unsigned sequence;
+	while (reader.Read(dc, sequence))
+	{
+		stats->ConfirmReceived(connection, dc.position, dc.color);
+		// Skip commands already contained in the table snapshot
+		if (sequence < tableSequence_)
+			continue;
+		table_->DrawCircle(dc.position, dc.color);
+		tableSequence_ = sequence + 1;
+		tableTick_ = dc.tick;
+	}
+}
+
+void SceneReplication::HandleTableSnapshot(Connection* connection, MemoryBuffer& msg)
+{
+	tableSequence_ = msg.ReadUInt();
+	tableTick_ = msg.ReadUInt();
+	table_->ReadSnapshotBand(msg);
+	++tableBands_;
+
+	// Deltas may have been waiting for the band
+	ApplyPendingDeltas(connection);
+}
 
-	DrawCircle(drawAt, color);
-}
\ No newline at end of file
+void SceneReplication::HandleDrawConfirmDelta(Connection* connection, MemoryBuffer& msg)
+{
+	// Deltas arrive unreliably and out of order. One that skips commands or bands still in flight is held back in case
+	// they arrive during this network update
+	DrawDeltaHeader header;
+	header.Read(msg);
+	if (!ApplyDrawConfirmDelta(connection, header, msg))
+	{
+		pendingDeltas_.Store(header.base_, header.end_, msg.GetData(), msg.GetSize());
+		return;
+	}
+
+	ApplyPendingDeltas(connection);
+}
+
+void SceneReplication::ApplyPendingDeltas(Connection* connection)
+{
+	// Each applied delta may be what the next held one builds on. Deltas overlap, so one may start before the commands
+	// the client has and still cover more; those ending before are of no use anymore
+	const PendingDelta* delta;
+	while ((delta = pendingDeltas_.FindCovering(tableSequence_)) != 0)
+	{
+		MemoryBuffer msg(delta->data_, delta->size_);
+		DrawDeltaHeader header;
+		header.Read(msg);
+		unsigned sequence = tableSequence_;
+		if (!ApplyDrawConfirmDelta(connection, header, msg) || tableSequence_ == sequence)
+			break;
+	}
+}
+
+bool SceneReplication::ApplyDrawConfirmDelta(Connection* connection, const DrawDeltaHeader& header, MemoryBuffer& msg)
+{
+	if (header.base_ > tableSequence_ || header.numBands_ > tableBands_)
+		return false;
+
+	DrawStats* stats = GetSubsystem<DrawStats>();
+	DrawConfirmReader reader(msg);
+	DrawCommand dc;
+	unsigned sequence;
+	while (reader.Read(dc, sequence))
+	{
+		// Deltas overlap until the server sees the acknowledgement
+		if (sequence < tableSequence_)
+			continue;
+		stats->ConfirmReceived(connection, dc.position, dc.color);
+		table_->DrawCircle(dc.position, dc.color);
+		tableTick_ = dc.tick;
+	}
+	tableSequence_ = Max(tableSequence_, header.end_);
+	stats->RequestsAcknowledged(connection, header.lastRequest_);
+
+	if (header.lastRequest_ > requestAck_)
+	{
+		requestAck_ = header.lastRequest_;
+		if (prediction_)
+			prediction_->Acknowledge(requestAck_);
+	}
+
+	// Acknowledged even when nothing was new, in case the previous acknowledgement was lost
+	PooledMessage ack(GetSubsystem<MessagePool>());
+	ack->WriteUInt(tableSequence_);
+	ack->WriteUInt(requestAck_);
+	connection->SendMessage(MSG_DRAWDELTAACK, false, false, *ack);
+	return true;
+}
+
+void SceneReplication::HandleDrawDeltaAck(Connection* connection, MemoryBuffer& msg)
+{
+	ClientState* state = GetClient(connection);
+	if (!state)
+		return;
+
+	// Acknowledgements may arrive out of order, the baseline only moves forward
+	unsigned sequence = msg.ReadUInt();
+	unsigned request = msg.ReadUInt();
+	if (sequence > state->baseline_ && sequence <= history_->GetEnd())
+		state->baseline_ = sequence;
+	if (request > state->ackedRequest_ && request <= state->lastRequest_)
+		state->ackedRequest_ = request;
+}
+
+void SceneReplication::HandleDrawPredicted(StringHash eventType, VariantMap& eventData)
+{
+	using namespace DrawPredicted;
+
+	prediction_->Add(eventData[P_SEQUENCE].GetUInt(), eventData[P_POSITION].GetVector2(), eventData[P_COLOR].GetColor());
+}
+
+void SceneReplication::HandleDrawRequestAck(Connection* connection, MemoryBuffer& msg)
+{
+	// Accepted requests are in the table by now, in the color the server chose. Rejected ones just disappear
+	unsigned lastRequest = msg.ReadUInt();
+	GetSubsystem<DrawStats>()->RequestsAcknowledged(connection, lastRequest);
+	if (prediction_)
+		prediction_->Acknowledge(lastRequest);
+}
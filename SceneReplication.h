@@ -23,25 +23,72 @@
 #pragma once
 
 #include "Sample.h"
+#include "AdmissionControl.h"
 #include "Common.h"
+#include "DeltaCache.h"
+#include "DrawDecoder.h"
+#include "DrawCommand.h"
+#include "DrawHistory.h"
+#include "DrawLog.h"
+#include "DrawingTable.h"
+#include "FlushRate.h"
+#include "InterestFanout.h"
+#include "InterestGrid.h"
+#include "LoadGenerator.h"
+#include "PredictionLayer.h"
+#include "SendScheduler.h"
+#include "SlotMap.h"
 
 namespace Urho3D
 {
 
 class Button;
 class Connection;
+class MemoryBuffer;
 class Scene;
 class Text;
 class UIElement;
+class VectorBuffer;
 
 }
 
-struct DrawCommand
+class CirclePainter;
+
+/// Server side state of a connected client.
+struct ClientState
 {
-	DrawCommand() : position(Vector2::ZERO), color(Color::RED) {}
-	DrawCommand(Vector2 p, Color c) : position(p), color(c) {}
-	Vector2 position;
-	Color	color;
+	/// Construct.
+	ClientState() : connection_(0), interestID_(0), lastRequest_(0), baseline_(0), numBands_(0), ackedRequest_(0), ackPending_(false),
+		regionPending_(false) {}
+
+	/// Client connection.
+	Connection* connection_;
+	/// Controllable object.
+	WeakPtr<Node> object_;
+	/// Painter component of the controllable object.
+	WeakPtr<CirclePainter> painter_;
+	/// Interest group ID in the interest grid.
+	unsigned interestID_;
+	/// Region of interest reported since the previous network update.
+	IntRect pendingRegion_;
+	/// Client sequence number of the last draw request processed.
+	unsigned lastRequest_;
+	/// Sequence number of the next command the client needs, as last acknowledged (baseline delta mode.)
+	unsigned baseline_;
+	/// Number of table snapshot bands sent to the client.
+	unsigned numBands_;
+	/// Last draw request acknowledgement the client confirmed receiving (baseline delta mode.)
+	unsigned ackedRequest_;
+	/// Send budget and queues of the messages to the client.
+	SendScheduler scheduler_;
+	/// Adaptive rate at which messages to the client are flushed.
+	FlushRate flushRate_;
+	/// Budget of the client's draw requests.
+	RequestBucket requests_;
+	/// Whether lastRequest_ changed since the previous acknowledgement.
+	bool ackPending_;
+	/// Whether pendingRegion_ is to be applied.
+	bool regionPending_;
 };
 
 /// Scene network replication example.
@@ -58,6 +105,8 @@ public:
     /// Construct.
     SceneReplication(Context* context);
 
+    /// Setup before engine initialization. Reads dedicated server options from the command line.
+    virtual void Setup();
     /// Setup after engine initialization and before running the main loop.
     virtual void Start();
 
@@ -92,12 +141,20 @@ private:
 	void CheckAuthority();
     /// Handle the logic post-update event.
     void HandlePostUpdate(StringHash eventType, VariantMap& eventData);
+	/// Handle the logic update event: run the server ticks due at the fixed tick rate (dedicated server only.)
+	void HandleServerTick(StringHash eventType, VariantMap& eventData);
+	/// Apply the draw requests of one server tick lasting timeStep seconds and advance to the next (server only.)
+	void RunTick(float timeStep);
     /// Handle pressing the connect button.
     void HandleConnect(StringHash eventType, VariantMap& eventData);
     /// Handle pressing the disconnect button.
     void HandleDisconnect(StringHash eventType, VariantMap& eventData);
     /// Handle pressing the start server button.
     void HandleStartServer(StringHash eventType, VariantMap& eventData);
+	/// Start server on the configured port.
+	void StartServer();
+	/// Open the draw log and continue the table and history from what it holds (server only.)
+	void OpenDrawLog();
     /// Handle connection status change (just update the buttons that should be shown.)
     void HandleConnectionStatus(StringHash eventType, VariantMap& eventData);
     /// Handle a client connecting to the server.
@@ -106,15 +163,75 @@ private:
     void HandleClientDisconnected(StringHash eventType, VariantMap& eventData);
     /// Handle remote event from server which tells our controlled object node ID.
     void HandleClientObjectID(StringHash eventType, VariantMap& eventData);
-	/// Handle remote event from client which tells where to draw new circle.
-	void HandleDrawCommandRequest(StringHash eventType, VariantMap& eventData);
-	// Handle remote event from server which tells where to draw confirmed command and in which color
-	void HandleDrawCommandConfirmed(StringHash eventType, VariantMap& eventData);
-	// Draw circle
-	void DrawCircle(const Vector2& drawAt, const Color& c);
-
-    /// Mapping from client connections to controllable objects.
-    HashMap<Connection*, WeakPtr<Node> > serverObjects_;
+	/// Handle custom network messages carrying draw command batches.
+	void HandleNetworkMessage(StringHash eventType, VariantMap& eventData);
+	/// Handle network update: broadcast draw commands confirmed since the previous update (server only.)
+	void HandleNetworkUpdate(StringHash eventType, VariantMap& eventData);
+	/// Handle batch from client which tells where to draw new circles: pass it to the decoder.
+	void HandleDrawRequestBatch(Connection* connection, MemoryBuffer& msg);
+	/// Draw the commands decoded since the previous tick that pass admission control and take over their request
+	/// acknowledgements (server only.)
+	void ApplyDecodedRequests(float timeStep);
+	/// Update the overload state and start a tick in every client's request budget (server only.)
+	void UpdateAdmission(float timeStep);
+	// Handle batch from server which tells where to draw confirmed commands and in which color
+	void HandleDrawConfirmBatch(Connection* connection, MemoryBuffer& msg);
+	/// Append history range [start, end) as a draw confirm batch.
+	void WriteDrawCommands(VectorBuffer& msg, unsigned start, unsigned end) const;
+	/// Append history entries with the given ascending sequence numbers as a draw confirm batch.
+	void WriteDrawCommands(VectorBuffer& msg, const unsigned* sequences, unsigned count) const;
+	/// Send history range [start, end) to one client, split into batches.
+	void SendDrawCommands(ClientState& state, unsigned start, unsigned end);
+	// Handle table snapshot band sent by the server on connect
+	void HandleTableSnapshot(Connection* connection, MemoryBuffer& msg);
+	/// Handle own draw request queued from input: draw it as a prediction (client only.)
+	void HandleDrawPredicted(StringHash eventType, VariantMap& eventData);
+	/// Handle acknowledgement of own draw requests: resolve their predictions (client only.)
+	void HandleDrawRequestAck(Connection* connection, MemoryBuffer& msg);
+	/// Return state of a connected client, or null if unknown.
+	ClientState* GetClient(Connection* connection);
+	/// Remove a client's controllable object and forget its state (server only.)
+	void RemoveClient(Connection* connection);
+	/// Acknowledge draw requests processed since the previous network update (server only.)
+	void SendRequestAcks();
+	/// Send history range [start, end) to each connection, only the commands touching its region of interest. Batches are
+	/// encoded once per interest group.
+	void SendFilteredDrawCommands(unsigned start, unsigned end);
+	/// Send each client the commands confirmed since its acknowledged baseline, unreliably, together with its request
+	/// acknowledgement (baseline delta mode, server only.)
+	void SendDrawDeltas();
+	/// Handle delta from server: apply it if it follows what the table already has, otherwise hold it back (client only.)
+	void HandleDrawConfirmDelta(Connection* connection, MemoryBuffer& msg);
+	/// Apply delta and acknowledge it. Return false without reading further if it skips commands or bands not yet received.
+	bool ApplyDrawConfirmDelta(Connection* connection, const DrawDeltaHeader& header, MemoryBuffer& msg);
+	/// Apply held back deltas that follow what the table has now (client only.)
+	void ApplyPendingDeltas(Connection* connection);
+	/// Handle acknowledgement of a delta: advance the client's baseline (baseline delta mode, server only.)
+	void HandleDrawDeltaAck(Connection* connection, MemoryBuffer& msg);
+	/// Handle region of interest reported by a client.
+	void HandleInterestRegion(Connection* connection, MemoryBuffer& msg);
+	/// Apply reported regions of interest and send the current pixels of newly covered areas. Must be called when
+	/// everything confirmed has been broadcast, or in baseline delta mode (server only.)
+	void UpdateInterestRegions();
+	/// Adapt a client's flush rate to the statistics of its link and hold its messages unless it is due a flush (server only.)
+	void UpdateFlushRate(ClientState& state, float timeStep);
+	/// Send the current pixels of a client's region outside oldRegion as snapshot bands. Bands are compressed once per
+	/// network update on first use.
+	void SendCatchUpBands(ClientState& state, const IntRect& oldRegion);
+	/// Drop the backlog of clients with more than MAX_QUEUED_BYTES waiting and resynchronize them from snapshot bands. Must
+	/// be called when everything confirmed has been broadcast (server only.)
+	void ResyncOverflowingClients();
+	/// Report visible table region to the server when it changes (client only.)
+	void SendInterestRegion();
+	/// Copy table pixels modified since the previous upload to the table texture.
+	void UploadTable();
+	/// Send table snapshot and the commands issued after it to a joining client.
+	void SendTableSnapshot(ClientState& state);
+
+    /// Connected clients with their controllable objects and request state, densely packed for the per-tick loops.
+    SlotMap<ClientState> clients_;
+    /// Mapping from client connections to handles in clients_.
+    HashMap<Connection*, unsigned> clientHandles_;
     /// Button container element.
     SharedPtr<UIElement> buttonContainer_;
     /// Server address line editor element.
@@ -129,11 +246,99 @@ private:
     SharedPtr<Text> instructionsText_;
 	// Table texture
 	SharedPtr<Texture2D> tableTexture_;
-	// History of draw cmds
-	Vector<DrawCommand> history;
+	/// Table pixels. Authoritative on the server.
+	SharedPtr<DrawingTable> table_;
+	/// Own predicted circles composited over the table for display (client only.)
+	SharedPtr<PredictionLayer> prediction_;
+	/// Reusable buffer for packing the dirty table rectangle before upload.
+	PODVector<unsigned char> uploadBuffer_;
+	// History of draw cmds, compacted after each broadcast (server only.)
+	SharedPtr<DrawHistory> history_;
+	/// Log of confirmed draw commands, null if not logging (server only.)
+	SharedPtr<DrawLog> drawLog_;
+	/// Draw log file name, empty for none.
+	String drawLogFile_;
+	/// First history entry not yet broadcast to clients.
+	unsigned broadcastStart_;
+	/// Regions of interest of clients (server only.)
+	InterestGrid interest_;
+	/// Reusable interest query result (server only.)
+	PODVector<unsigned> interestQuery_;
+	/// Encoding state of filtered broadcasts per interest group ID (server only.)
+	Vector<InterestFanout> fanout_;
+	/// Interest groups with commands to encode in the current filtered broadcast (server only.)
+	PODVector<InterestFanout*> fanoutWork_;
+	/// Encode filtered broadcasts on worker threads.
+	bool parallelFanout_;
+	/// Send confirms as unreliable deltas against each client's acknowledged baseline instead of reliable batches.
+	bool baselineDeltas_;
+	/// Draw circles with anti-aliased edges.
+	bool antiAlias_;
+	/// Send budget per client in bytes per second, zero for unlimited.
+	float sendBudget_;
+	/// Flush each client at a rate adapted to the congestion of its link instead of every network update.
+	bool adaptiveRate_;
+	/// Decode draw requests on a thread of their own.
+	bool decodeThread_;
+	/// Draw requests per second admitted from each client, zero for unlimited.
+	float requestRate_;
+	/// Draw requests each client may send in a burst, zero for one second of the rate.
+	float requestBurst_;
+	/// Request budgets and overload state (server only.)
+	AdmissionControl admission_;
+	/// Draw request decoder handing commands to the server tick (server only.)
+	DrawDecoder decoder_;
+	/// Reusable selection of commands for one client's delta (server only.)
+	PODVector<unsigned> deltaSelection_;
+	/// Visible table region last reported to the server (client only.)
+	IntRect interestRegion_;
+	/// Catch-up bands compressed during the current network update, empty if not yet needed (server only.)
+	Vector<VectorBuffer> catchUpBands_;
+	/// Cached compressed snapshot messages for joining clients (server only.)
+	Vector<VectorBuffer> snapshotMessages_;
+	/// Sequence number of the first command not contained in the cached snapshot (server only.)
+	unsigned snapshotSequence_;
+	/// Server tick the cached snapshot was taken in (server only.)
+	unsigned snapshotTick_;
+	/// Current server tick, stamped on the commands it applies (server only.)
+	unsigned tick_;
+	/// Fixed tick rate of the dedicated server in ticks per second.
+	float tickRate_;
+	/// Time not yet consumed by fixed ticks in seconds (server only.)
+	float tickAcc_;
+	/// Sequence number of the next confirmed command to draw (client only.)
+	unsigned tableSequence_;
+	/// Server tick of the latest confirmed command drawn, or of the table snapshot (client only.)
+	unsigned tableTick_;
+	/// Number of table snapshot bands received (client only.)
+	unsigned tableBands_;
+	/// Last own draw request acknowledged by a delta (client only.)
+	unsigned requestAck_;
+	/// Deltas that arrived ahead of what they build on during the current network update (client only.)
+	DeltaCache pendingDeltas_;
     /// ID of own controllable object (client only.)
     unsigned clientObjectID_;
 	/// ID of own controllable object (client only.)
 	bool	clientObjectAuth_;
+	/// Dedicated server without graphics, UI or input.
+	bool	headless_;
+	/// UDP port to serve on or connect to.
+	unsigned short serverPort_;
+	/// Server address for the load generator.
+	String serverAddress_;
+	/// Number of simulated painters. Nonzero runs the load generator instead of the sample.
+	unsigned numBots_;
+	/// Draw requests per second per simulated painter.
+	float botRate_;
+	/// Spatial distribution of simulated draw requests.
+	BotDistribution botDistribution_;
+	/// Load generator (bot mode only.)
+	SharedPtr<LoadGenerator> loadGenerator_;
+	/// Draw statistics export file, empty for none.
+	String statsFile_;
+	/// Draw statistics export interval in seconds.
+	float statsInterval_;
+	/// Broadcast draw commands kept in the history for deltas and replay.
+	unsigned historyHorizon_;
 
 };
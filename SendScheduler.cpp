@@ -0,0 +1,159 @@
+#include <Urho3D/Math/MathDefs.h>
+#include <Urho3D/Network/Connection.h>
+
+#include <cstring>
+
+#include "SendScheduler.h"
+
+SendScheduler::SendScheduler() :
+	budget_(0.0f),
+	tokens_(0.0f),
+	heldTime_(0.0f),
+	deferredBytes_(0),
+	droppedBytes_(0),
+	held_(false)
+{
+}
+
+void SendScheduler::SetBudget(float bytesPerSecond)
+{
+	budget_ = Max(bytesPerSecond, 0.0f);
+	tokens_ = budget_ * SEND_BURST_SECONDS;
+}
+
+void SendScheduler::Send(int msgID, bool reliable, const VectorBuffer& msg, SendPriority priority)
+{
+	if (!connection_)
+		return;
+
+	// A reliable message follows every waiting one, so it may have to join a less urgent class
+	unsigned cls = priority;
+	if (reliable)
+	{
+		for (unsigned i = cls + 1; i < MAX_SEND_PRIORITIES; ++i)
+		{
+			if (queues_[i].IsWaiting())
+				cls = i;
+		}
+	}
+
+	bool waiting = false;
+	for (unsigned i = 0; i <= cls; ++i)
+		waiting |= queues_[i].IsWaiting();
+
+	if (!held_ && (!budget_ || (!waiting && tokens_ > 0.0f)))
+	{
+		connection_->SendMessage(msgID, reliable, reliable, msg);
+		tokens_ -= msg.GetSize();
+	}
+	else if (reliable)
+		Enqueue(queues_[cls], msgID, msg.GetData(), msg.GetSize());
+	else
+		droppedBytes_ += msg.GetSize();
+}
+
+void SendScheduler::Update(float timeStep)
+{
+	// A held connection gets the budget of the whole hold on its next flush
+	if (held_)
+		heldTime_ += timeStep;
+	if (budget_)
+		tokens_ = Min(tokens_ + budget_ * timeStep, budget_ * (SEND_BURST_SECONDS + heldTime_));
+	if (held_ || !connection_)
+		return;
+	heldTime_ = 0.0f;
+
+	// Most urgent class first. A class gets nothing while a more urgent one still waits
+	for (unsigned i = 0; i < MAX_SEND_PRIORITIES; ++i)
+	{
+		SendQueue& queue = queues_[i];
+		while (queue.IsWaiting() && (!budget_ || tokens_ > 0.0f))
+		{
+			const QueuedMessage& msg = queue.messages_[queue.head_++];
+			connection_->SendMessage(msg.msgID_, true, true, queue.data_.GetData() + msg.offset_, msg.size_);
+			tokens_ -= msg.size_;
+		}
+		Compact(queue);
+	}
+}
+
+void SendScheduler::Clear()
+{
+	for (unsigned i = 0; i < MAX_SEND_PRIORITIES; ++i)
+	{
+		SendQueue& queue = queues_[i];
+		if (queue.IsWaiting())
+			droppedBytes_ += queue.data_.GetSize() - queue.messages_[queue.head_].offset_;
+		queue.messages_.Clear();
+		queue.data_.Clear();
+		queue.head_ = 0;
+	}
+}
+
+unsigned SendScheduler::GetQueueDepth() const
+{
+	// Sent messages are removed at the end of each update
+	unsigned depth = 0;
+	for (unsigned i = 0; i < MAX_SEND_PRIORITIES; ++i)
+		depth += queues_[i].messages_.Size();
+	return depth;
+}
+
+unsigned SendScheduler::GetQueuedBytes() const
+{
+	unsigned bytes = 0;
+	for (unsigned i = 0; i < MAX_SEND_PRIORITIES; ++i)
+		bytes += queues_[i].data_.GetSize();
+	return bytes;
+}
+
+unsigned SendScheduler::GetNumQueued(int msgID) const
+{
+	unsigned count = 0;
+	for (unsigned i = 0; i < MAX_SEND_PRIORITIES; ++i)
+	{
+		const SendQueue& queue = queues_[i];
+		for (unsigned j = queue.head_; j < queue.messages_.Size(); ++j)
+		{
+			if (queue.messages_[j].msgID_ == msgID)
+				++count;
+		}
+	}
+	return count;
+}
+
+void SendScheduler::Enqueue(SendQueue& queue, int msgID, const unsigned char* data, unsigned size)
+{
+	QueuedMessage msg;
+	msg.msgID_ = msgID;
+	msg.offset_ = queue.data_.GetSize();
+	msg.size_ = size;
+	queue.messages_.Push(msg);
+	queue.data_.Seek(msg.offset_);
+	queue.data_.Write(data, size);
+	deferredBytes_ += size;
+}
+
+void SendScheduler::Compact(SendQueue& queue)
+{
+	if (!queue.head_)
+		return;
+
+	if (!queue.IsWaiting())
+	{
+		// The common case, memory is kept for the next backlog
+		queue.messages_.Clear();
+		queue.data_.Clear();
+	}
+	else
+	{
+		unsigned start = queue.messages_[queue.head_].offset_;
+		unsigned size = queue.data_.GetSize() - start;
+		memmove(queue.data_.GetModifiableData(), queue.data_.GetData() + start, size);
+		queue.data_.Resize(size);
+		queue.messages_.Erase(0, queue.head_);
+		for (unsigned i = 0; i < queue.messages_.Size(); ++i)
+			queue.messages_[i].offset_ -= start;
+	}
+	queue.head_ = 0;
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <Urho3D/Container/Ptr.h>
+#include <Urho3D/IO/VectorBuffer.h>
+
+namespace Urho3D
+{
+
+class Connection;
+
+}
+
+using namespace Urho3D;
+
+/// Burst the send budget may accumulate while idle, in seconds of its rate.
+static const float SEND_BURST_SECONDS = 0.1f;
+/// Bytes waiting per connection past which the backlog is dropped and the client resynchronized instead.
+static const unsigned MAX_QUEUED_BYTES = 4 * 1024 * 1024;
+
+/// Priority classes of outgoing messages, most urgent first.
+enum SendPriority
+{
+	/// Draw confirms, deltas and acknowledgements.
+	SP_CONFIRM = 0,
+	/// Table snapshot and catch-up bands, sent with what is left of the budget.
+	SP_BULK,
+	/// Number of priority classes.
+	MAX_SEND_PRIORITIES
+};
+
+/// Reliable message waiting for send budget.
+struct QueuedMessage
+{
+	/// Message ID.
+	int msgID_;
+	/// Offset of the message bytes in the queue data.
+	unsigned offset_;
+	/// Message size in bytes.
+	unsigned size_;
+};
+
+/// Messages of one priority class waiting for send budget.
+struct SendQueue
+{
+	/// Construct empty.
+	SendQueue() : head_(0) {}
+
+	/// Return whether messages are waiting.
+	bool IsWaiting() const { return head_ < messages_.Size(); }
+
+	/// Waiting messages from head_ on.
+	PODVector<QueuedMessage> messages_;
+	/// Bytes of the waiting messages.
+	VectorBuffer data_;
+	/// First message not yet sent.
+	unsigned head_;
+};
+
+/// Per connection token bucket send budget with priority classes. Messages go out right away while the budget lasts and
+/// nothing they must follow waits. Otherwise reliable messages are copied to the queue of their class and sent on a later
+/// update, most urgent class first, while unreliable ones are dropped as the next update supersedes them. Reliable
+/// messages never overtake each other: one sent while a less urgent class waits joins that class. While held, everything
+/// reliable is queued and the budget keeps accumulating until the next flush.
+class SendScheduler
+{
+public:
+	/// Construct without a connection and with unlimited budget.
+	SendScheduler();
+
+	/// Set connection to send to.
+	void SetConnection(Connection* connection) { connection_ = connection; }
+	/// Set budget in bytes per second. Zero is unlimited.
+	void SetBudget(float bytesPerSecond);
+	/// Send message or queue it until there is budget.
+	void Send(int msgID, bool reliable, const VectorBuffer& msg, SendPriority priority);
+	/// Refill the budget for elapsed time and send waiting messages while it lasts, unless held.
+	void Update(float timeStep);
+	/// Set whether to hold all messages until a later update.
+	void SetHold(bool enable) { held_ = enable; }
+	/// Drop all waiting messages.
+	void Clear();
+
+	/// Return budget in bytes per second, zero if unlimited.
+	float GetBudget() const { return budget_; }
+	/// Return whether messages are held.
+	bool IsHeld() const { return held_; }
+	/// Return number of messages waiting.
+	unsigned GetQueueDepth() const;
+	/// Return bytes of the messages waiting.
+	unsigned GetQueuedBytes() const;
+	/// Return number of messages with ID waiting.
+	unsigned GetNumQueued(int msgID) const;
+	/// Return whether more than MAX_QUEUED_BYTES are waiting.
+	bool IsOverflowing() const { return GetQueuedBytes() > MAX_QUEUED_BYTES; }
+	/// Return total bytes that had to wait for budget or the next flush.
+	unsigned long long GetDeferredBytes() const { return deferredBytes_; }
+	/// Return total bytes of unreliable messages dropped for lack of budget, and of waiting messages cleared.
+	unsigned long long GetDroppedBytes() const { return droppedBytes_; }
+
+private:
+	/// Copy message to the queue of a class.
+	void Enqueue(SendQueue& queue, int msgID, const unsigned char* data, unsigned size);
+	/// Remove sent messages and move the remaining bytes to the front.
+	void Compact(SendQueue& queue);
+
+	/// Connection to send to.
+	WeakPtr<Connection> connection_;
+	/// Waiting messages per priority class.
+	SendQueue queues_[MAX_SEND_PRIORITIES];
+	/// Budget in bytes per second, zero if unlimited.
+	float budget_;
+	/// Bytes that may be sent now. Negative after a message larger than what was left.
+	float tokens_;
+	/// Time held since the last flush in seconds.
+	float heldTime_;
+	/// Total bytes that had to wait.
+	unsigned long long deferredBytes_;
+	/// Total bytes dropped, unreliable or cleared.
+	unsigned long long droppedBytes_;
+	/// Hold messages until a later update.
+	bool held_;
+};
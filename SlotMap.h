@@ -0,0 +1,127 @@
+#pragma once
+
+#include <Urho3D/Container/Vector.h>
+#include <Urho3D/Math/MathDefs.h>
+
+using namespace Urho3D;
+
+/// Bits of a slot map handle holding the slot index. The rest hold the slot's generation.
+static const unsigned SLOTMAP_INDEX_BITS = 20;
+/// Mask of the slot index in a slot map handle.
+static const unsigned SLOTMAP_INDEX_MASK = (1 << SLOTMAP_INDEX_BITS) - 1;
+/// Mask of a slot's generation before it is shifted into a handle.
+static const unsigned SLOTMAP_GENERATION_MASK = (1 << (32 - SLOTMAP_INDEX_BITS)) - 1;
+
+/// Dense storage addressed by stable handles. Values are contiguous, so iterating them touches no other memory. A handle
+/// finds its value through a slot table; removal moves the last value into the hole and updates that slot. Slot
+/// generations make handles of removed values detectable; a slot whose generation wraps is retired, so no handle
+/// becomes valid again.
+template <class T> class SlotMap
+{
+public:
+	/// Insert value. Return its handle.
+	unsigned Insert(const T& value)
+	{
+		unsigned slot;
+		if (freeSlots_.Size())
+		{
+			slot = freeSlots_.Back();
+			freeSlots_.Pop();
+		}
+		else
+		{
+			slot = slots_.Size();
+			slots_.Push(0);
+			generations_.Push(0);
+		}
+
+		slots_[slot] = values_.Size();
+		values_.Push(value);
+		unsigned handle = MakeHandle(slot);
+		handles_.Push(handle);
+		return handle;
+	}
+
+	/// Remove value by handle. Return false if the handle is stale.
+	bool Erase(unsigned handle)
+	{
+		unsigned index = GetIndex(handle);
+		if (index == M_MAX_UNSIGNED)
+			return false;
+
+		unsigned last = values_.Size() - 1;
+		if (index != last)
+		{
+			values_[index] = values_[last];
+			handles_[index] = handles_[last];
+			slots_[handles_[index] & SLOTMAP_INDEX_MASK] = index;
+		}
+		values_.Pop();
+		handles_.Pop();
+
+		ReleaseSlot(handle & SLOTMAP_INDEX_MASK);
+		return true;
+	}
+
+	/// Remove all values. Outstanding handles become stale.
+	void Clear()
+	{
+		for (unsigned i = 0; i < handles_.Size(); ++i)
+			ReleaseSlot(handles_[i] & SLOTMAP_INDEX_MASK);
+		values_.Clear();
+		handles_.Clear();
+	}
+
+	/// Return dense index of handle, or M_MAX_UNSIGNED if stale. Indices change when values are removed.
+	unsigned GetIndex(unsigned handle) const
+	{
+		unsigned slot = handle & SLOTMAP_INDEX_MASK;
+		if (slot >= slots_.Size() || generations_[slot] > SLOTMAP_GENERATION_MASK || MakeHandle(slot) != handle)
+			return M_MAX_UNSIGNED;
+		return slots_[slot];
+	}
+
+	/// Return value by handle, or null if stale.
+	T* Get(unsigned handle)
+	{
+		unsigned index = GetIndex(handle);
+		return index != M_MAX_UNSIGNED ? &values_[index] : 0;
+	}
+
+	/// Return value by dense index.
+	T& operator [](unsigned index) { return values_[index]; }
+	/// Return value by dense index.
+	const T& operator [](unsigned index) const { return values_[index]; }
+	/// Return handle of value at dense index.
+	unsigned GetHandle(unsigned index) const { return handles_[index]; }
+	/// Return number of values.
+	unsigned Size() const { return values_.Size(); }
+	/// Return whether there are no values.
+	bool Empty() const { return values_.Empty(); }
+
+private:
+	/// Return current handle of slot.
+	unsigned MakeHandle(unsigned slot) const
+	{
+		return ((generations_[slot] & SLOTMAP_GENERATION_MASK) << SLOTMAP_INDEX_BITS) | slot;
+	}
+
+	/// Advance slot's generation and make it reusable, unless the generation wrapped and a reused slot could match a stale
+	/// handle again. A retired slot keeps the generation past the mask, which GetIndex() rejects.
+	void ReleaseSlot(unsigned slot)
+	{
+		if ((++generations_[slot] & SLOTMAP_GENERATION_MASK) != 0)
+			freeSlots_.Push(slot);
+	}
+
+	/// Values, densely packed.
+	Vector<T> values_;
+	/// Handle of each value.
+	PODVector<unsigned> handles_;
+	/// Dense index per slot.
+	PODVector<unsigned> slots_;
+	/// Generation per slot, incremented on removal.
+	PODVector<unsigned> generations_;
+	/// Unused slots.
+	PODVector<unsigned> freeSlots_;
+};
@@ -0,0 +1,171 @@
+// Holding back of early deltas on the client: storing, finding the delta that covers a sequence number, and replaying a
+// shuffled delta stream with arena chunks reused across network updates. Exits with failure if any check fails.
+
+#include <Urho3D/Core/ProcessUtils.h>
+#include <Urho3D/Core/StringUtils.h>
+#include <Urho3D/IO/MemoryBuffer.h>
+#include <Urho3D/IO/VectorBuffer.h>
+#include <Urho3D/Math/Random.h>
+
+#include "Common.h"
+#include "DeltaCache.h"
+#include "DrawCommand.h"
+
+#include <cstring>
+
+/// Network updates in the replayed stream.
+static const unsigned NUM_UPDATES = 2000;
+/// Deltas received per network update, in shuffled order.
+static const unsigned DELTAS_PER_UPDATE = 16;
+/// Payload bytes after the header of each replayed delta, about a full delta of drawing commands.
+static const unsigned PAYLOAD_SIZE = 450;
+
+static unsigned failures = 0;
+
+static void Check(bool condition, const String& what)
+{
+	if (!condition)
+	{
+		PrintLine("FAILED: " + what, true);
+		++failures;
+	}
+}
+
+static void TestStore()
+{
+	DeltaCache cache;
+	unsigned char a[] = { 1, 2, 3 };
+	unsigned char b[] = { 4, 5, 6, 7 };
+
+	Check(!cache.FindCovering(0), "empty cache finds nothing");
+	Check(cache.Store(10, 20, a, sizeof a), "store delta");
+	Check(cache.GetSize() == 1 && cache.GetBytes() == sizeof a, "size and bytes after store");
+	Check(!cache.FindCovering(9), "delta not found before its base");
+
+	const PendingDelta* delta = cache.FindCovering(10);
+	Check(delta && delta->base_ == 10 && delta->end_ == 20, "delta found at its base");
+	Check(delta && delta->size_ == sizeof a && delta->data_ != a && !memcmp(delta->data_, a, sizeof a), "bytes are copied");
+	delta = cache.FindCovering(15);
+	Check(delta && delta->base_ == 10, "delta found inside its range");
+
+	// A resend with the same base replaces the held delta
+	Check(cache.Store(10, 25, b, sizeof b), "store resend");
+	delta = cache.FindCovering(12);
+	Check(cache.GetSize() == 1, "resend replaces instead of adding");
+	Check(delta && delta->end_ == 25 && delta->size_ == sizeof b && !memcmp(delta->data_, b, sizeof b), "resend contents");
+
+	// Of several covering deltas the one reaching furthest wins
+	cache.Store(12, 40, a, sizeof a);
+	cache.Store(14, 30, a, sizeof a);
+	delta = cache.FindCovering(14);
+	Check(delta && delta->base_ == 12, "furthest reaching delta found");
+
+	// Deltas ending at or before the sequence number are forgotten
+	delta = cache.FindCovering(30);
+	Check(delta && delta->base_ == 12, "covering delta found after others expired");
+	Check(cache.GetSize() == 1, "expired deltas forgotten");
+
+	cache.Reset();
+	Check(cache.GetSize() == 0 && cache.GetBytes() == 0 && !cache.FindCovering(12), "reset forgets all");
+}
+
+static void TestFull()
+{
+	DeltaCache cache;
+	unsigned char byte = 0;
+	bool stored = true;
+	for (unsigned i = 0; i < MAX_PENDING_DELTAS; ++i)
+		stored &= cache.Store(i * 10, i * 10 + 10, &byte, 1);
+	Check(stored, "store up to the maximum");
+	Check(!cache.Store(MAX_PENDING_DELTAS * 10, MAX_PENDING_DELTAS * 10 + 10, &byte, 1), "store beyond the maximum fails");
+	Check(cache.Store(0, 5, &byte, 1), "replacing a held delta succeeds when full");
+
+	// Every delta stays findable while earlier ones are erased and their probe sequences close up
+	bool found = true;
+	for (unsigned i = 1; i < MAX_PENDING_DELTAS; ++i)
+	{
+		const PendingDelta* delta = cache.FindCovering(i * 10);
+		found &= delta && delta->base_ == i * 10;
+		found &= cache.GetSize() == MAX_PENDING_DELTAS - i;
+	}
+	Check(found, "deltas findable while others are erased");
+}
+
+static void TestReplay()
+{
+	// Deltas that chain up sequence numbers, received in shuffled order within each network update
+	Vector<Vector<VectorBuffer> > stream(NUM_UPDATES);
+	unsigned end = 0;
+	for (unsigned i = 0; i < NUM_UPDATES; ++i)
+	{
+		Vector<VectorBuffer>& messages = stream[i];
+		messages.Resize(DELTAS_PER_UPDATE);
+		for (unsigned j = 0; j < DELTAS_PER_UPDATE; ++j)
+		{
+			DrawDeltaHeader header;
+			header.base_ = end;
+			header.end_ = end + 1 + Rand() % MAX_DRAWCOMMANDS_PER_DELTA;
+			header.Write(messages[j]);
+			for (unsigned k = 0; k < PAYLOAD_SIZE; ++k)
+				messages[j].WriteUByte((unsigned char)k);
+			end = header.end_;
+		}
+		for (unsigned j = DELTAS_PER_UPDATE - 1; j > 0; --j)
+			Swap(messages[j], messages[Rand() % (j + 1)]);
+	}
+
+	// Apply deltas whose base has been reached, hold the others and apply them once it is
+	DeltaCache cache;
+	unsigned sequence = 0;
+	unsigned numHeld = 0;
+	unsigned chunksAfterWarmup = 0;
+	bool intact = true;
+	for (unsigned i = 0; i < NUM_UPDATES; ++i)
+	{
+		const Vector<VectorBuffer>& messages = stream[i];
+		for (unsigned j = 0; j < messages.Size(); ++j)
+		{
+			MemoryBuffer msg(messages[j].GetData(), messages[j].GetSize());
+			DrawDeltaHeader header;
+			header.Read(msg);
+			if (header.base_ > sequence)
+			{
+				cache.Store(header.base_, header.end_, messages[j].GetData(), messages[j].GetSize());
+				++numHeld;
+				continue;
+			}
+			sequence = Max(sequence, header.end_);
+
+			while (const PendingDelta* delta = cache.FindCovering(sequence))
+			{
+				MemoryBuffer held(delta->data_, delta->size_);
+				header.Read(held);
+				intact &= held.GetSize() - held.GetPosition() == PAYLOAD_SIZE && held.ReadUByte() == 0;
+				sequence = header.end_;
+			}
+		}
+
+		cache.Reset();
+		if (i == 0)
+			chunksAfterWarmup = cache.GetArenaChunks();
+	}
+
+	Check(numHeld > 0, "shuffled stream holds deltas back");
+	Check(sequence == end, "replay applies every delta");
+	Check(intact, "held deltas read back intact");
+	Check(cache.GetArenaChunks() == chunksAfterWarmup, "arena allocates no chunks after warming up");
+}
+
+int main(int argc, char** argv)
+{
+	SetRandomSeed(1);
+
+	TestStore();
+	TestFull();
+	TestReplay();
+
+	if (failures)
+		ErrorExit(ToString("%u checks failed", failures));
+	PrintLine("All delta cache checks passed");
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,224 @@
+// Round trip and quantization error of the draw command codecs, and their byte counts against the VariantMap remote events
+// and float colors they replaced. Exits with failure if any check fails.
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/ProcessUtils.h>
+#include <Urho3D/Core/StringUtils.h>
+#include <Urho3D/Core/Variant.h>
+#include <Urho3D/IO/MemoryBuffer.h>
+#include <Urho3D/IO/VectorBuffer.h>
+#include <Urho3D/Math/Random.h>
+#include <Urho3D/Urho2D/Drawable2D.h>
+
+#include "Common.h"
+#include "DrawCommand.h"
+#include "DrawHistory.h"
+
+/// Commands per batch in the byte count comparison.
+static const unsigned BATCH_SIZE = 100;
+
+static unsigned failures = 0;
+
+static void Check(bool condition, const String& what)
+{
+	if (!condition)
+	{
+		PrintLine("FAILED: " + what, true);
+		++failures;
+	}
+}
+
+/// Return bytes a Serializer VLE takes.
+static unsigned VLEBytes(unsigned value)
+{
+	return value < 0x80 ? 1 : value < 0x4000 ? 2 : value < 0x200000 ? 3 : 4;
+}
+
+/// Return bits a BitWriter VLE takes: groups of four value bits and a continuation bit.
+static unsigned VLEBits(unsigned value)
+{
+	unsigned groups = 1;
+	while (value >>= 4)
+		++groups;
+	return groups * 5;
+}
+
+static Vector2 RandomPosition()
+{
+	float halfExtent = DRAWING_TABLE_SIZE * PIXEL_SIZE / 2.0f;
+	return Vector2(Random(-halfExtent, halfExtent), Random(-halfExtent, halfExtent));
+}
+
+static void TestRequestBatch()
+{
+	PODVector<Vector2> positions;
+	for (unsigned i = 0; i < BATCH_SIZE; ++i)
+		positions.Push(RandomPosition());
+
+	// As CirclePainter sends it
+	VectorBuffer msg;
+	msg.WriteUInt(1234);
+	msg.WriteVLE(positions.Size());
+	BitWriter writer(msg);
+	for (unsigned i = 0; i < positions.Size(); ++i)
+		WriteDrawPosition(writer, positions[i]);
+	writer.Flush();
+
+	unsigned expected = 4 + VLEBytes(BATCH_SIZE) + (BATCH_SIZE * 2 * DRAWCOMMAND_POSITION_BITS + 7) / 8;
+	Check(msg.GetSize() == expected, ToString("request batch is %u bytes, expected %u", msg.GetSize(), expected));
+
+	MemoryBuffer source(msg.GetData(), msg.GetSize());
+	Check(source.ReadUInt() == 1234, "request batch first sequence");
+	Check(source.ReadVLE() == BATCH_SIZE, "request batch count");
+	BitReader reader(source);
+	for (unsigned i = 0; i < positions.Size(); ++i)
+		Check(ReadDrawPosition(reader) == QuantizeDrawPosition(positions[i]), ToString("request %u position", i));
+	Check(!reader.IsEof(), "request batch ends early");
+}
+
+static void TestQuantization()
+{
+	// Half a step of the position and channel grids, with some slack for float rounding
+	float positionError = DRAWING_TABLE_SIZE * PIXEL_SIZE / ((1 << DRAWCOMMAND_POSITION_BITS) - 1) * 0.501f;
+	float channelError = 1.0f / ((1 << DRAWCOMMAND_COLOR_BITS) - 1) * 0.501f;
+	for (unsigned i = 0; i < BATCH_SIZE; ++i)
+	{
+		Vector2 position = RandomPosition();
+		Vector2 quantized = QuantizeDrawPosition(position);
+		Check(Abs(quantized.x_ - position.x_) <= positionError && Abs(quantized.y_ - position.y_) <= positionError,
+			ToString("position %u quantization error", i));
+
+		Color color(Random(1.0f), Random(1.0f), Random(1.0f));
+		Color packed = UnpackDrawColor(PackDrawColor(color));
+		Check(packed == QuantizeDrawColor(color), ToString("packed color %u round trip", i));
+		Check(Abs(packed.r_ - color.r_) <= channelError && Abs(packed.g_ - color.g_) <= channelError &&
+			Abs(packed.b_ - color.b_) <= channelError, ToString("color %u quantization error", i));
+	}
+
+	// Table corners survive, positions off the table are clamped to its border
+	float halfExtent = DRAWING_TABLE_SIZE * PIXEL_SIZE / 2.0f;
+	Check(QuantizeDrawPosition(Vector2(-halfExtent, halfExtent)) == Vector2(-halfExtent, halfExtent), "table corner position");
+	Check(QuantizeDrawPosition(Vector2(2.0f * halfExtent, -2.0f * halfExtent)) == Vector2(halfExtent, -halfExtent),
+		"off table position clamped");
+
+	// The painter color attribute as a delta update writes it: variant data without the type
+	VectorBuffer floatColor;
+	floatColor.WriteVariantData(Variant(Color::RED));
+	VectorBuffer packedColor;
+	packedColor.WriteVariantData(Variant(PackDrawColor(Color::RED)));
+	Check(packedColor.GetSize() == 4, ToString("packed painter color is %u bytes, expected 4", packedColor.GetSize()));
+	Check(floatColor.GetSize() == 16, ToString("float painter color is %u bytes, expected 16", floatColor.GetSize()));
+}
+
+static void TestConfirmBatch(Context* context)
+{
+	// Runs with gaps as interest filtering leaves them, a few colors and ticks that sometimes skip
+	const Color palette[] = { Color(0.1f, 0.2f, 0.3f), Color(1.0f, 0.5f, 0.0f), Color(0.33f, 0.66f, 0.99f) };
+	SharedPtr<DrawHistory> history(new DrawHistory(context));
+	PODVector<unsigned> sequences;
+	unsigned tick = 70;
+	for (unsigned i = 0; i < BATCH_SIZE; ++i)
+	{
+		if (Rand() % 4 == 0)
+		{
+			for (unsigned skip = 1 + Rand() % 20; skip; --skip)
+				history->Push(DrawCommand(RandomPosition(), Color::WHITE, tick));
+		}
+		if (Rand() % 3 == 0)
+			tick += 1 + Rand() % 3;
+		sequences.Push(history->Push(DrawCommand(RandomPosition(), palette[Rand() % 3], tick)));
+	}
+
+	// Split into runs as the server does for filtered confirms and deltas
+	VectorBuffer msg;
+	WriteDrawConfirms(msg, *history, &sequences[0], sequences.Size(), 0);
+
+	MemoryBuffer source(msg.GetData(), msg.GetSize());
+	DrawConfirmReader reader(source);
+	DrawCommand command;
+	unsigned readSequence;
+	for (unsigned i = 0; i < sequences.Size(); ++i)
+	{
+		const DrawCommand& written = history->Get(sequences[i]);
+		if (!reader.Read(command, readSequence))
+		{
+			Check(false, ToString("confirm batch ends after %u commands", i));
+			return;
+		}
+		Check(readSequence == sequences[i], ToString("confirm %u sequence", i));
+		Check(command.position == QuantizeDrawPosition(written.position), ToString("confirm %u position", i));
+		Check(command.color == QuantizeDrawColor(written.color), ToString("confirm %u color", i));
+		Check(command.tick == written.tick, ToString("confirm %u tick", i));
+	}
+	Check(!reader.Read(command, readSequence), "confirm batch has extra commands");
+
+	// A delta with everything filtered out still carries the tick
+	VectorBuffer empty;
+	WriteDrawConfirms(empty, *history, 0, 0, tick);
+	MemoryBuffer emptySource(empty.GetData(), empty.GetSize());
+	Check(emptySource.ReadUInt() == 0 && emptySource.ReadUInt() == tick && emptySource.ReadVLE() == 0, "empty confirm batch header");
+}
+
+static void TestConfirmBytes()
+{
+	// One painter's clicks of one tick: a single run, one color and one tick
+	VectorBuffer msg;
+	DrawConfirmWriter writer(msg, 0, 0, BATCH_SIZE);
+	writer.BeginRun(0, BATCH_SIZE);
+	for (unsigned i = 0; i < BATCH_SIZE; ++i)
+		writer.Write(DrawCommand(RandomPosition(), Color::RED));
+	writer.Finish();
+
+	unsigned commandBits = 2 * DRAWCOMMAND_POSITION_BITS + 2;
+	unsigned bits = VLEBits(0) + VLEBits(BATCH_SIZE) + BATCH_SIZE * commandBits + 3 * DRAWCOMMAND_COLOR_BITS;
+	unsigned expected = 4 + 4 + VLEBytes(BATCH_SIZE) + (bits + 7) / 8;
+	Check(msg.GetSize() == expected, ToString("confirm batch is %u bytes, expected %u", msg.GetSize(), expected));
+
+	// What each command took as a remote event: event type and a VariantMap with position and color
+	VariantMap eventData;
+	eventData[StringHash("Position")] = RandomPosition();
+	eventData[StringHash("Color")] = Color::RED;
+	VectorBuffer event;
+	event.WriteStringHash(StringHash("DrawCommandConfirm"));
+	event.WriteVariantMap(eventData);
+	Check(event.GetSize() == 39, ToString("remote event is %u bytes, expected 39", event.GetSize()));
+
+	PrintLine(ToString("%u commands: remote events %u bytes, confirm batch %u bytes (%.2f per command)", BATCH_SIZE,
+		BATCH_SIZE * event.GetSize(), msg.GetSize(), (float)msg.GetSize() / BATCH_SIZE));
+}
+
+static void TestDeltaHeader()
+{
+	DrawDeltaHeader header;
+	header.base_ = 100000;
+	header.end_ = 100250;
+	header.numBands_ = 3;
+	header.lastRequest_ = 77;
+
+	VectorBuffer msg;
+	header.Write(msg);
+	Check(msg.GetSize() == 13, ToString("delta header is %u bytes, expected 13", msg.GetSize()));
+
+	MemoryBuffer source(msg.GetData(), msg.GetSize());
+	DrawDeltaHeader read;
+	read.Read(source);
+	Check(read.base_ == header.base_ && read.end_ == header.end_ && read.numBands_ == header.numBands_ &&
+		read.lastRequest_ == header.lastRequest_, "delta header round trip");
+}
+
+int main(int argc, char** argv)
+{
+	SharedPtr<Context> context(new Context());
+	SetRandomSeed(1);
+
+	TestRequestBatch();
+	TestQuantization();
+	TestConfirmBatch(context);
+	TestConfirmBytes();
+	TestDeltaHeader();
+
+	if (failures)
+		ErrorExit(ToString("%u checks failed", failures));
+	PrintLine("All draw codec checks passed");
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,128 @@
+// Round trip of the draw log: commands appended and committed tick by tick, read back after reopening read-only and found
+// by tick and by time. The last tick grows the file, which must not commit its commands early. Exits with failure if any
+// check fails.
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/ProcessUtils.h>
+#include <Urho3D/Core/StringUtils.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/IO/File.h>
+#include <Urho3D/IO/FileSystem.h>
+#include <Urho3D/Math/Random.h>
+#include <Urho3D/Urho2D/Drawable2D.h>
+
+#include "DrawLog.h"
+
+/// Commands applied per tick.
+static const unsigned COMMANDS_PER_TICK = 10;
+/// Ticks committed before the last one, leaving the file just short of growing.
+static const unsigned NUM_TICKS = DRAWLOG_GROW_RECORDS / COMMANDS_PER_TICK - 3;
+/// Commands of the last tick, crossing the initial file size.
+static const unsigned LAST_TICK_COMMANDS = 100;
+/// Byte offset of the committed record count in the log header.
+static const unsigned HEADER_COUNT_OFFSET = 12;
+
+static unsigned failures = 0;
+
+static void Check(bool condition, const String& what)
+{
+	if (!condition)
+	{
+		PrintLine("FAILED: " + what, true);
+		++failures;
+	}
+}
+
+static void DeleteLog(FileSystem* fileSystem, const String& fileName)
+{
+	fileSystem->Delete(fileName);
+	fileSystem->Delete(fileName + ".idx");
+	fileSystem->Delete(fileName + ".ckpt");
+}
+
+/// Return committed record count in the header of the file, read past the mapping of the log writing it.
+static unsigned ReadCommittedCount(Context* context, const String& fileName)
+{
+	File file(context, fileName);
+	if (!file.IsOpen() || !file.Seek(HEADER_COUNT_OFFSET))
+		return M_MAX_UNSIGNED;
+	return file.ReadUInt();
+}
+
+static void TestRoundTrip(Context* context, const String& fileName)
+{
+	float halfExtent = DRAWING_TABLE_SIZE * PIXEL_SIZE / 2.0f;
+	Vector<DrawCommand> commands;
+	unsigned startTime = Time::GetTimeSinceEpoch();
+
+	SharedPtr<DrawLog> log(new DrawLog(context));
+	Check(log->Open(fileName), "create log");
+	for (unsigned tick = 0; tick <= NUM_TICKS; ++tick)
+	{
+		unsigned count = tick < NUM_TICKS ? COMMANDS_PER_TICK : LAST_TICK_COMMANDS;
+		for (unsigned i = 0; i < count; ++i)
+		{
+			DrawCommand command(Vector2(Random(-halfExtent, halfExtent), Random(-halfExtent, halfExtent)),
+				Color(Random(), Random(), Random()), tick);
+			log->Append(command);
+			commands.Push(command);
+		}
+		if (tick < NUM_TICKS)
+			log->Commit();
+	}
+
+	unsigned committed = NUM_TICKS * COMMANDS_PER_TICK;
+	Check(committed + LAST_TICK_COMMANDS > DRAWLOG_GROW_RECORDS, "last tick grows the log");
+	Check(log->IsOpen() && log->GetNumRecords() == commands.Size(), "every command appended");
+	Check(ReadCommittedCount(context, fileName) == committed, "growing leaves the last tick uncommitted");
+
+	log->Commit();
+	Check(ReadCommittedCount(context, fileName) == commands.Size(), "last tick committed");
+	log->Close();
+	unsigned endTime = Time::GetTimeSinceEpoch();
+
+	SharedPtr<DrawLog> reader(new DrawLog(context));
+	Check(reader->Open(fileName, true), "reopen log read-only");
+	Check(reader->GetNumRecords() == commands.Size(), "reopened record count");
+
+	bool matches = true;
+	for (unsigned i = 0; i < commands.Size(); ++i)
+	{
+		DrawCommand command;
+		matches &= reader->Read(i, command) && command.position == commands[i].position &&
+			command.color == QuantizeDrawColor(commands[i].color) && command.tick == commands[i].tick;
+	}
+	DrawCommand command;
+	Check(matches, "records read back");
+	Check(!reader->Read(commands.Size(), command), "read past the end fails");
+
+	Check(reader->FindTick(0) == 0, "find first tick");
+	Check(reader->FindTick(NUM_TICKS / 2) == NUM_TICKS / 2 * COMMANDS_PER_TICK, "find middle tick");
+	Check(reader->FindTick(NUM_TICKS) == committed, "find last tick");
+	Check(reader->FindTick(NUM_TICKS + 1) == commands.Size(), "find tick after the log");
+
+	// Every index entry was taken between the start and end times
+	const PODVector<DrawLogIndexEntry>& index = reader->GetIndex();
+	Check(index.Size() == (commands.Size() - 1) / DRAWLOG_INDEX_INTERVAL + 1, "index entry per interval");
+	Check(reader->FindTime(startTime) == 0, "find time before the log");
+	Check(reader->FindTime(endTime + 1) == index.Back().sequence_, "find time after the log");
+}
+
+int main(int argc, char** argv)
+{
+	SharedPtr<Context> context(new Context());
+	context->RegisterSubsystem(new FileSystem(context));
+	SetRandomSeed(1);
+
+	FileSystem* fileSystem = context->GetSubsystem<FileSystem>();
+	String fileName = fileSystem->GetProgramDir() + "DrawLogTest.dlog";
+	DeleteLog(fileSystem, fileName);
+
+	TestRoundTrip(context, fileName);
+
+	DeleteLog(fileSystem, fileName);
+	if (failures)
+		ErrorExit(ToString("%u checks failed", failures));
+	PrintLine("All draw log checks passed");
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,113 @@
+// Scaling of the parallel confirm fanout over 1 to 64 threads. Encodes one tick of commands for many clients with regions of
+// interest with the encoding SceneReplication uses with -parallelfanout, and checks that every thread count
+// encodes the same bytes. Arguments: clients (256), commands per tick (8192), ticks per measurement (20).
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/ProcessUtils.h>
+#include <Urho3D/Core/StringUtils.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Core/WorkQueue.h>
+#include <Urho3D/IO/VectorBuffer.h>
+#include <Urho3D/Math/Random.h>
+#include <Urho3D/Urho2D/Drawable2D.h>
+
+#include "Common.h"
+#include "DrawHistory.h"
+#include "DrawingTable.h"
+#include "InterestFanout.h"
+#include "InterestGrid.h"
+
+/// Return checksum of all encoded batches.
+static unsigned Checksum(const Vector<InterestFanout>& groups)
+{
+	unsigned hash = 0;
+	for (unsigned i = 0; i < groups.Size(); ++i)
+	{
+		for (unsigned j = 0; j < groups[i].numMessages_; ++j)
+		{
+			const VectorBuffer& msg = groups[i].messages_[j];
+			for (unsigned k = 0; k < msg.GetSize(); ++k)
+				hash = SDBMHash(hash, msg.GetData()[k]);
+		}
+	}
+	return hash;
+}
+
+int main(int argc, char** argv)
+{
+	SharedPtr<Context> context(new Context());
+	context->RegisterSubsystem(new Time(context));
+
+	unsigned numClients = argc > 1 ? Max(ToUInt(argv[1]), 1U) : 256;
+	unsigned numCommands = argc > 2 ? Max(ToUInt(argv[2]), 1U) : 8192;
+	unsigned numTicks = argc > 3 ? Max(ToUInt(argv[3]), 1U) : 20;
+
+	// One tick of commands spread over the table
+	SetRandomSeed(1);
+	SharedPtr<DrawingTable> table(new DrawingTable(context));
+	SharedPtr<DrawHistory> drawHistory(new DrawHistory(context));
+	drawHistory->SetHorizon(numCommands);
+	float halfExtent = DRAWING_TABLE_SIZE * PIXEL_SIZE / 2.0f;
+	for (unsigned i = 0; i < numCommands; ++i)
+		drawHistory->Push(DrawCommand(Vector2(Random(-halfExtent, halfExtent), Random(-halfExtent, halfExtent)), Color::RED, 1));
+
+	// Clients looking at parts of the table of varying size
+	InterestGrid interest;
+	for (unsigned i = 0; i < numClients; ++i)
+	{
+		int size = 96 + Rand() % 160;
+		int left = Rand() % (DRAWING_TABLE_SIZE - size);
+		int top = Rand() % (DRAWING_TABLE_SIZE - size);
+		interest.Subscribe(IntRect(left, top, left + size, top + size));
+	}
+
+	Vector<InterestFanout> groups(interest.GetMaxGroups());
+	PODVector<unsigned> query;
+	for (unsigned i = 0; i < numCommands; ++i)
+	{
+		interest.Query(table->GetCircleRect(drawHistory->Get(i).position), query);
+		for (unsigned j = 0; j < query.Size(); ++j)
+			groups[query[j]].selection_.Push(i);
+	}
+
+	// Only groups with commands are encoded, as in SceneReplication
+	PODVector<InterestFanout*> busyGroups;
+	for (unsigned i = 0; i < groups.Size(); ++i)
+	{
+		if (!groups[i].selection_.Empty())
+			busyGroups.Push(&groups[i]);
+	}
+
+	PrintLine(ToString("%u clients in %u interest groups, %u commands per tick", numClients, busyGroups.Size(), numCommands));
+	PrintLine("threads  ms/tick  speedup");
+
+	float singleThreadTime = 0.0f;
+	unsigned expectedChecksum = 0;
+	bool deterministic = true;
+	for (unsigned numThreads = 1; numThreads <= 64; numThreads *= 2)
+	{
+		// The main thread works too, as in SceneReplication
+		SharedPtr<WorkQueue> queue(new WorkQueue(context));
+		queue->CreateThreads(numThreads - 1);
+
+		HiresTimer timer;
+		for (unsigned tick = 0; tick < numTicks; ++tick)
+			EncodeInterestFanouts(busyGroups, *drawHistory, queue);
+		float time = timer.GetUSec(false) / 1000.0f / numTicks;
+
+		unsigned checksum = Checksum(groups);
+		if (numThreads == 1)
+		{
+			singleThreadTime = time;
+			expectedChecksum = checksum;
+		}
+		else if (checksum != expectedChecksum)
+			deterministic = false;
+
+		PrintLine(ToString("%7u  %7.3f  %7.2f", numThreads, time, singleThreadTime / time));
+	}
+
+	if (!deterministic)
+		ErrorExit("Encoded batches differ between thread counts");
+	return EXIT_SUCCESS;
+}
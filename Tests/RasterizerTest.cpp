@@ -0,0 +1,206 @@
+// Pixels written by the circle rasterizer, with and without anti-aliasing, on whatever span fill the build selected. Exits
+// with failure if any check fails.
+
+#include <Urho3D/Core/ProcessUtils.h>
+#include <Urho3D/Core/StringUtils.h>
+#include <Urho3D/Math/Random.h>
+
+#include "CircleRasterizer.h"
+
+#include <cstring>
+
+/// Side of the target in pixels, as the drawing table.
+static const int TARGET_SIZE = 512;
+/// Bytes past the end of each target row that must never be written.
+static const int GUARD_SIZE = 48;
+/// Target background.
+static const unsigned char BACKGROUND = 0xff;
+
+static unsigned failures = 0;
+
+static void Check(bool condition, const String& what)
+{
+	if (!condition)
+	{
+		PrintLine("FAILED: " + what, true);
+		++failures;
+	}
+}
+
+/// RGB888 target with a guard band after each row.
+struct TestTarget
+{
+	TestTarget() :
+		pixels_((TARGET_SIZE * 3 + GUARD_SIZE) * TARGET_SIZE),
+		target_(0, TARGET_SIZE, TARGET_SIZE, TARGET_SIZE * 3 + GUARD_SIZE)
+	{
+		target_.data_ = &pixels_[0];
+		Clear();
+	}
+
+	void Clear() { memset(&pixels_[0], BACKGROUND, pixels_.Size()); }
+	const unsigned char* GetPixel(int x, int y) const { return &pixels_[y * target_.stride_ + x * 3]; }
+	bool IsBackground(int x, int y) const
+	{
+		const unsigned char* pixel = GetPixel(x, y);
+		return pixel[0] == BACKGROUND && pixel[1] == BACKGROUND && pixel[2] == BACKGROUND;
+	}
+	bool IsGuardIntact() const
+	{
+		for (int y = 0; y < TARGET_SIZE; ++y)
+		{
+			for (int i = TARGET_SIZE * 3; i < target_.stride_; ++i)
+			{
+				if (pixels_[y * target_.stride_ + i] != BACKGROUND)
+					return false;
+			}
+		}
+		return true;
+	}
+
+	PODVector<unsigned char> pixels_;
+	RasterTarget target_;
+};
+
+/// Return whether every pixel outside the rectangle is untouched.
+static bool IsUntouchedOutside(const TestTarget& target, const IntRect& rect)
+{
+	for (int y = 0; y < TARGET_SIZE; ++y)
+	{
+		for (int x = 0; x < TARGET_SIZE; ++x)
+		{
+			if ((x < rect.left_ || x >= rect.right_ || y < rect.top_ || y >= rect.bottom_) && !target.IsBackground(x, y))
+				return false;
+		}
+	}
+	return true;
+}
+
+static void TestOpaque(TestTarget& target)
+{
+	// Short spans are filled by scalar code, long ones by SIMD blocks and a scalar tail
+	const float diameters[] = { 4.0f, 10.0f, 33.0f, 64.0f, 129.0f };
+	const unsigned char rgb[] = { 51, 102, 204 };
+	for (unsigned i = 0; i < sizeof diameters / sizeof diameters[0]; ++i)
+	{
+		float r = diameters[i] * 0.5f;
+		Vector2 center(Random(150.0f, 350.0f), Random(150.0f, 350.0f));
+		target.Clear();
+		IntRect rect = RasterizeCircle(target.target_, center, diameters[i], Color(0.2f, 0.4f, 0.8f), false);
+
+		unsigned painted = 0;
+		bool exact = true;
+		for (int y = rect.top_; y < rect.bottom_; ++y)
+		{
+			for (int x = rect.left_; x < rect.right_; ++x)
+			{
+				if (target.IsBackground(x, y))
+					continue;
+				++painted;
+				exact &= memcmp(target.GetPixel(x, y), rgb, 3) == 0;
+			}
+		}
+
+		float area = M_PI * r * r;
+		Check(exact, ToString("diameter %.0f pixels all in the circle color", diameters[i]));
+		Check(Abs(painted - area) <= 2.0f * M_PI * r + 4.0f, ToString("diameter %.0f covers %u pixels, expected about %.0f",
+			diameters[i], painted, area));
+		Check(!target.IsBackground((int)center.x_, (int)center.y_), ToString("diameter %.0f center painted", diameters[i]));
+		Check(rect.Width() <= (int)diameters[i] + 2 && rect.Height() <= (int)diameters[i] + 2,
+			ToString("diameter %.0f touched rectangle %dx%d", diameters[i], rect.Width(), rect.Height()));
+		Check(IsUntouchedOutside(target, rect), ToString("diameter %.0f writes outside its rectangle", diameters[i]));
+	}
+}
+
+static void TestTranslucent(TestTarget& target)
+{
+	// Blending over a uniform background gives the same pixel everywhere, whichever code path filled the span
+	target.Clear();
+	IntRect rect = RasterizeCircle(target.target_, Vector2(256.0f, 256.0f), 100.0f, Color(0.0f, 0.5f, 1.0f, 0.5f), false);
+	const unsigned char expected[] = { 127, 191, 255 };
+	bool uniform = true;
+	for (int y = rect.top_; y < rect.bottom_; ++y)
+	{
+		for (int x = rect.left_; x < rect.right_; ++x)
+		{
+			if (!target.IsBackground(x, y))
+				uniform &= memcmp(target.GetPixel(x, y), expected, 3) == 0;
+		}
+	}
+	Check(uniform, "translucent circle blends every pixel alike");
+}
+
+static void TestAntiAlias(TestTarget& target)
+{
+	// Black on white: each pixel's darkness is its coverage, which sums to the circle area
+	const float diameters[] = { 4.0f, 10.0f, 64.0f };
+	for (unsigned i = 0; i < sizeof diameters / sizeof diameters[0]; ++i)
+	{
+		float r = diameters[i] * 0.5f;
+		Vector2 center(Random(150.0f, 350.0f), Random(150.0f, 350.0f));
+		target.Clear();
+		IntRect rect = RasterizeCircle(target.target_, center, diameters[i], Color::BLACK, true);
+
+		float coverage = 0.0f;
+		unsigned partial = 0;
+		for (int y = rect.top_; y < rect.bottom_; ++y)
+		{
+			for (int x = rect.left_; x < rect.right_; ++x)
+			{
+				unsigned char value = target.GetPixel(x, y)[0];
+				coverage += (BACKGROUND - value) / 255.0f;
+				if (value != 0 && value != BACKGROUND)
+					++partial;
+			}
+		}
+
+		float area = M_PI * r * r;
+		Check(Abs(coverage - area) <= 0.05f * area + 1.0f, ToString("antialiased diameter %.0f coverage %.1f, expected %.1f",
+			diameters[i], coverage, area));
+		Check(partial > 0, ToString("antialiased diameter %.0f has blended edge pixels", diameters[i]));
+		Check(target.GetPixel((int)center.x_, (int)center.y_)[0] == 0, ToString("antialiased diameter %.0f center covered",
+			diameters[i]));
+		Check(IsUntouchedOutside(target, rect), ToString("antialiased diameter %.0f writes outside its rectangle", diameters[i]));
+	}
+}
+
+static void TestClipping(TestTarget& target)
+{
+	target.Clear();
+	for (unsigned i = 0; i < 2; ++i)
+	{
+		bool antiAlias = i == 1;
+		IntRect left = RasterizeCircle(target.target_, Vector2(-10.0f, 100.0f), 64.0f, Color::RED, antiAlias);
+		IntRect right = RasterizeCircle(target.target_, Vector2(TARGET_SIZE + 10.0f, 300.0f), 64.0f, Color::RED, antiAlias);
+		IntRect corner = RasterizeCircle(target.target_, Vector2(TARGET_SIZE - 1.0f, TARGET_SIZE - 1.0f), 64.0f, Color::RED,
+			antiAlias);
+		Check(left.left_ == 0 && right.right_ == TARGET_SIZE && corner.right_ == TARGET_SIZE && corner.bottom_ == TARGET_SIZE,
+			"circles over the border are clipped to the target");
+		Check(RasterizeCircle(target.target_, Vector2(-100.0f, -100.0f), 64.0f, Color::RED, antiAlias) == IntRect::ZERO,
+			"circle outside the target touches nothing");
+	}
+	Check(target.IsGuardIntact(), "clipped circles write past the row end");
+}
+
+int main(int argc, char** argv)
+{
+#if defined(__AVX2__)
+	PrintLine("Span fill: AVX2");
+#elif defined(URHO3D_SSE)
+	PrintLine("Span fill: SSE2");
+#else
+	PrintLine("Span fill: scalar");
+#endif
+
+	SetRandomSeed(1);
+	TestTarget target;
+	TestOpaque(target);
+	TestTranslucent(target);
+	TestAntiAlias(target);
+	TestClipping(target);
+
+	if (failures)
+		ErrorExit(ToString("%u checks failed", failures));
+	PrintLine("All rasterizer checks passed");
+	return EXIT_SUCCESS;
+}
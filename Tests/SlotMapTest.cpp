@@ -0,0 +1,128 @@
+// Handles, dense storage and stale handle detection of the slot map that keeps the server's client state. Exits with
+// failure if any check fails.
+
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Core/ProcessUtils.h>
+#include <Urho3D/Core/StringUtils.h>
+#include <Urho3D/Math/Random.h>
+
+#include "SlotMap.h"
+
+/// Operations in the randomized comparison.
+static const unsigned NUM_OPERATIONS = 100000;
+
+static unsigned failures = 0;
+
+static void Check(bool condition, const String& what)
+{
+	if (!condition)
+	{
+		PrintLine("FAILED: " + what, true);
+		++failures;
+	}
+}
+
+/// Return whether the slot map holds exactly the reference values, each found by its handle and at its dense index.
+static bool Matches(SlotMap<unsigned>& map, const HashMap<unsigned, unsigned>& reference)
+{
+	if (map.Size() != reference.Size())
+		return false;
+	for (unsigned i = 0; i < map.Size(); ++i)
+	{
+		HashMap<unsigned, unsigned>::ConstIterator j = reference.Find(map.GetHandle(i));
+		if (j == reference.End() || j->second_ != map[i] || map.GetIndex(j->first_) != i)
+			return false;
+	}
+	return true;
+}
+
+static void TestBasics()
+{
+	SlotMap<unsigned> map;
+	unsigned a = map.Insert(10);
+	unsigned b = map.Insert(20);
+	unsigned c = map.Insert(30);
+	Check(map.Size() == 3 && *map.Get(a) == 10 && *map.Get(b) == 20 && *map.Get(c) == 30, "inserted values found");
+
+	// Removal moves the last value into the hole, its handle keeps working
+	Check(map.Erase(a), "erase live handle");
+	Check(map.Size() == 2 && map[0] == 30 && map.GetHandle(0) == c && *map.Get(c) == 30, "last value moved into the hole");
+	Check(!map.Get(a) && !map.Erase(a) && map.GetIndex(a) == M_MAX_UNSIGNED, "erased handle is stale");
+
+	// The freed slot is reused under a new generation
+	unsigned d = map.Insert(40);
+	Check((d & SLOTMAP_INDEX_MASK) == (a & SLOTMAP_INDEX_MASK) && d != a, "slot reused with a new generation");
+	Check(!map.Get(a) && *map.Get(d) == 40, "old handle of a reused slot stays stale");
+	Check(!map.Get(0xffffffff) && !map.Get(SLOTMAP_INDEX_MASK), "handles of unknown slots are stale");
+
+	map.Clear();
+	Check(map.Empty() && !map.Get(b) && !map.Get(c) && !map.Get(d), "clear makes every handle stale");
+}
+
+static void TestGenerationWrap()
+{
+	// Churn one slot until its generation wraps. It must be retired rather than hand out a handle seen before
+	SlotMap<unsigned> map;
+	unsigned first = map.Insert(0);
+	map.Erase(first);
+	unsigned handle = first;
+	for (unsigned i = 0; i < SLOTMAP_GENERATION_MASK; ++i)
+	{
+		handle = map.Insert(i);
+		map.Erase(handle);
+	}
+	Check((handle & SLOTMAP_INDEX_MASK) == (first & SLOTMAP_INDEX_MASK), "churned values reuse one slot");
+
+	unsigned next = map.Insert(1);
+	Check((next & SLOTMAP_INDEX_MASK) != (first & SLOTMAP_INDEX_MASK), "slot retired after its generation wraps");
+	Check(!map.Get(first) && !map.Get(handle) && *map.Get(next) == 1, "handles of a retired slot stay stale");
+}
+
+static void TestRandom()
+{
+	// Clients connecting and leaving in any order, compared with a map keyed by handle
+	SlotMap<unsigned> map;
+	HashMap<unsigned, unsigned> reference;
+	PODVector<unsigned> staleHandles;
+	bool matches = true;
+	bool stale = true;
+	for (unsigned i = 0; i < NUM_OPERATIONS; ++i)
+	{
+		if (reference.Empty() || Rand() % 3)
+		{
+			unsigned handle = map.Insert(i);
+			stale &= !reference.Contains(handle);
+			reference[handle] = i;
+		}
+		else
+		{
+			unsigned handle = map.GetHandle(Rand() % map.Size());
+			map.Erase(handle);
+			reference.Erase(handle);
+			staleHandles.Push(handle);
+		}
+
+		if (i % 1000 == 0)
+		{
+			matches &= Matches(map, reference);
+			for (unsigned j = 0; j < staleHandles.Size(); ++j)
+				stale &= !map.Get(staleHandles[j]);
+		}
+	}
+	Check(matches, "slot map matches the reference");
+	Check(stale, "erased handles stay stale");
+}
+
+int main(int argc, char** argv)
+{
+	SetRandomSeed(1);
+
+	TestBasics();
+	TestGenerationWrap();
+	TestRandom();
+
+	if (failures)
+		ErrorExit(ToString("%u checks failed", failures));
+	PrintLine("All slot map checks passed");
+	return EXIT_SUCCESS;
+}